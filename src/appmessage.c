@@ -3,11 +3,27 @@
 #include "libs/pebble-assist.h"
 #include "common.h"
 #include "light.h"
+#include "palette.h"
 
 static void in_received_handler(DictionaryIterator *iter, void *context);
 static void in_dropped_handler(AppMessageResult reason, void *context);
 static void out_sent_handler(DictionaryIterator *sent, void *context);
 static void out_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context);
+static bool retry(DictionaryIterator *failed, AppMessageResult reason);
+static void retry_callback(void *data);
+
+// Resends a failed message with jittered exponential backoff. A busy outbox
+// clears up quickly, a missing phone takes longer and an oversized message
+// never gets through, so each reason has its own delay and attempt count.
+#define RETRY_BUSY_DELAY 50
+#define RETRY_BUSY_TRIES 6
+#define RETRY_DISCONNECTED_DELAY 500
+#define RETRY_DISCONNECTED_TRIES 3
+
+static AppTimer *retry_timer;
+static uint8_t *retry_buffer;
+static uint16_t retry_size;
+static uint8_t retry_tries;
 
 void appmessage_init(void) {
 	app_message_register_inbox_received(in_received_handler);
@@ -18,6 +34,10 @@ void appmessage_init(void) {
 }
 
 static void in_received_handler(DictionaryIterator *iter, void *context) {
+	if (dict_find(iter, KEY_METHOD) && dict_find(iter, KEY_METHOD)->value->uint8 == KEY_METHOD_PALETTE) {
+		palette_in_received_handler(iter);
+		return;
+	}
 	light_in_received_handler(iter);
 }
 
@@ -25,9 +45,80 @@ static void in_dropped_handler(AppMessageResult reason, void *context) {
 }
 
 static void out_sent_handler(DictionaryIterator *sent, void *context) {
+	retry_tries = 0;
 	light_out_sent_handler(sent);
 }
 
 static void out_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context) {
+	LOG("out_failed: %d", reason);
+	if (retry(failed, reason)) return;
+	retry_tries = 0;
 	light_out_failed_handler(failed, reason);
 }
+
+static bool retry(DictionaryIterator *failed, AppMessageResult reason) {
+	// READY has its own backoff in light.c, which a READY from the phone cuts short.
+	if (dict_find(failed, KEY_METHOD) && dict_find(failed, KEY_METHOD)->value->uint8 == KEY_METHOD_READY) return false;
+	uint32_t delay;
+	switch (reason) {
+		case APP_MSG_BUSY:
+			if (retry_tries >= RETRY_BUSY_TRIES) return false;
+			delay = RETRY_BUSY_DELAY;
+			break;
+		case APP_MSG_NOT_CONNECTED:
+		case APP_MSG_APP_NOT_RUNNING:
+		case APP_MSG_SEND_TIMEOUT:
+			if (retry_tries >= RETRY_DISCONNECTED_TRIES) return false;
+			delay = RETRY_DISCONNECTED_DELAY;
+			break;
+		default:
+			return false;
+	}
+	if (retry_timer) return false;
+	retry_size = (uint8_t *) failed->end - (uint8_t *) failed->dictionary;
+	retry_buffer = malloc(retry_size);
+	if (!retry_buffer) return false;
+	memcpy(retry_buffer, failed->dictionary, retry_size);
+	delay <<= retry_tries++;
+	delay = delay / 2 + rand() % (delay / 2 + 1);
+	retry_timer = app_timer_register(delay, retry_callback, NULL);
+	return true;
+}
+
+static void retry_callback(void *data) {
+	retry_timer = NULL;
+	uint8_t *buffer = retry_buffer;
+	retry_buffer = NULL;
+	DictionaryIterator copy;
+	DictionaryIterator *iter;
+	if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+		// Someone else got the outbox first; count it as another busy attempt.
+		dict_read_begin_from_buffer(&copy, buffer, retry_size);
+		out_failed_handler(&copy, APP_MSG_BUSY, NULL);
+		free(buffer);
+		return;
+	}
+	for (Tuple *tuple = dict_read_begin_from_buffer(&copy, buffer, retry_size); tuple; tuple = dict_read_next(&copy)) {
+		switch (tuple->type) {
+			case TUPLE_BYTE_ARRAY:
+				dict_write_data(iter, tuple->key, tuple->value->data, tuple->length);
+				break;
+			case TUPLE_CSTRING:
+				dict_write_cstring(iter, tuple->key, tuple->value->cstring);
+				break;
+			case TUPLE_UINT:
+				if (tuple->length == 1) dict_write_uint8(iter, tuple->key, tuple->value->uint8);
+				else if (tuple->length == 2) dict_write_uint16(iter, tuple->key, tuple->value->uint16);
+				else dict_write_uint32(iter, tuple->key, tuple->value->uint32);
+				break;
+			case TUPLE_INT:
+				if (tuple->length == 1) dict_write_int8(iter, tuple->key, tuple->value->int8);
+				else if (tuple->length == 2) dict_write_int16(iter, tuple->key, tuple->value->int16);
+				else dict_write_int32(iter, tuple->key, tuple->value->int32);
+				break;
+		}
+	}
+	dict_write_end(iter);
+	app_message_outbox_send();
+	free(buffer);
+}
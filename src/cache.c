@@ -0,0 +1,73 @@
+#include <pebble.h>
+#include "cache.h"
+#include "common.h"
+#include "light.h"
+#include "fleet.h"
+#include "libs/pebble-assist.h"
+
+#define CACHE_MAX_CHUNKS 10
+
+typedef struct {
+	uint32_t version;
+	uint8_t num_lights;
+	uint8_t num_tags;
+	uint16_t length;
+} CacheHeader;
+
+static uint32_t loaded_version;
+
+void cache_load(void) {
+	CacheHeader header;
+	if (!persist_exists(KEY_CACHE) || persist_read_data(KEY_CACHE, &header, sizeof(header)) != sizeof(header)) return;
+	uint8_t *data = malloc(header.length);
+	if (!data) return;
+	for (uint8_t chunk = 0; chunk * PERSIST_DATA_MAX_LENGTH < header.length; chunk++) {
+		uint16_t offset = chunk * PERSIST_DATA_MAX_LENGTH;
+		uint16_t size = header.length - offset < PERSIST_DATA_MAX_LENGTH ? header.length - offset : PERSIST_DATA_MAX_LENGTH;
+		if (persist_read_data(KEY_CACHE_DATA + chunk, data + offset, size) != size) {
+			free(data);
+			return;
+		}
+	}
+	if (!fleet_resize(KEY_TYPE_LIGHT, header.num_lights) || !fleet_resize(KEY_TYPE_TAG, header.num_tags)) {
+		free(data);
+		return;
+	}
+	uint16_t offset = light_read_records(data, header.length, num_lights, KEY_TYPE_LIGHT);
+	light_read_records(data + offset, header.length - offset, num_tags, KEY_TYPE_TAG);
+	free(data);
+	loaded_version = header.version;
+	stale = true;
+	LOG("cache_load: %d lights, %d tags, %d bytes", num_lights, num_tags, header.length);
+}
+
+// Saves the phone's view of the rows under the version the watch computes for
+// it, so a cache is never certified for rows the phone didn't send.
+void cache_save(void) {
+	if (stale) return;
+	uint32_t version = light_version();
+	if (version == loaded_version) return;
+	CacheHeader header = {
+		.version = version,
+		.num_lights = num_lights,
+		.num_tags = num_tags,
+		.length = light_records_size(lights, num_lights) + light_records_size(tags, num_tags),
+	};
+	if (header.length > CACHE_MAX_CHUNKS * PERSIST_DATA_MAX_LENGTH) {
+		persist_delete(KEY_CACHE);
+		LOG("cache_save: %d bytes won't fit", header.length);
+		return;
+	}
+	uint8_t *data = malloc(header.length);
+	if (!data) return;
+	uint16_t offset = light_write_records(data, KEY_TYPE_LIGHT);
+	light_write_records(data + offset, KEY_TYPE_TAG);
+	for (uint8_t chunk = 0; chunk * PERSIST_DATA_MAX_LENGTH < header.length; chunk++) {
+		uint16_t offset = chunk * PERSIST_DATA_MAX_LENGTH;
+		uint16_t size = header.length - offset < PERSIST_DATA_MAX_LENGTH ? header.length - offset : PERSIST_DATA_MAX_LENGTH;
+		persist_write_data(KEY_CACHE_DATA + chunk, data + offset, size);
+	}
+	free(data);
+	int res = persist_write_data(KEY_CACHE, &header, sizeof(header));
+	LOG("cache_save: %d", res);
+}
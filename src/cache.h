@@ -0,0 +1,4 @@
+#pragma once
+
+void cache_load(void);
+void cache_save(void);
@@ -1,5 +1,8 @@
 #pragma once
 
+// Bumped whenever the watch and the JS stop understanding each other's messages.
+#define PROTOCOL_VERSION 1
+
 enum {
 	KEY_TYPE,
 	KEY_METHOD,
@@ -10,9 +13,43 @@ enum {
 	KEY_COLOR_S,
 	KEY_COLOR_B,
 	KEY_COLOR_K,
+	KEY_COUNT,
+	KEY_INBOX_SIZE,
+	KEY_DATA,
+	KEY_VERSION,
+	KEY_PROTOCOL,
+	KEY_SESSION,
+	KEY_OUTBOX_SIZE,
+	KEY_OPERATION,
+	KEY_SCENE,
+	KEY_PALETTE,
 	KEY_SETTINGS = 100,
+	KEY_SCENES,
+	KEY_PALETTE_COLORS,
+	KEY_CACHE = 200,
+	KEY_CACHE_DATA,
 };
 
+// PATCH messages resize the list to KEY_INDEX entries and carry KEY_COUNT
+// changed packed records back to back in KEY_DATA:
+// index, flags, hue, saturation, brightness, kelvin (uint16, little endian),
+// label length and then the label bytes without a terminator. The last PATCH
+// of a sync carries KEY_VERSION, a hash of the whole fleet. The watch computes
+// the same hash over the rows it holds, as the phone last sent them, and
+// reports it in READY and with its cache.
+enum {
+	RECORD_INDEX,
+	RECORD_FLAGS,
+	RECORD_HUE,
+	RECORD_SATURATION,
+	RECORD_BRIGHTNESS,
+	RECORD_KELVIN,
+	RECORD_LABEL_LENGTH = 7,
+	RECORD_LABEL,
+};
+
+#define RECORD_FLAG_ON 0x01
+
 enum {
 	KEY_TYPE_ERROR,
 	KEY_TYPE_LIGHT,
@@ -28,4 +65,8 @@ enum {
 	KEY_METHOD_TOGGLE,
 	KEY_METHOD_COLOR,
 	KEY_METHOD_READY,
+	KEY_METHOD_PATCH,
+	KEY_METHOD_SCENE_SAVE,
+	KEY_METHOD_SCENE_RESTORE,
+	KEY_METHOD_PALETTE,
 };
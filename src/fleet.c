@@ -0,0 +1,141 @@
+#include <pebble.h>
+#include "fleet.h"
+#include "libs/pebble-assist.h"
+#include "common.h"
+#include "light.h"
+
+// Lights, tags and their labels share one block that is reused in place
+// across syncs. The tables sit at the front; labels are interned at the back
+// and referenced by their distance from the end of the block. The block is
+// only rebuilt, which also drops labels nothing refers to any more, when the
+// tables or a new label no longer fit.
+
+#define FLEET_SLACK 64
+
+static bool rebuild(uint8_t new_num_lights, uint8_t new_num_tags, uint16_t extra);
+static uint16_t relabel(const uint8_t *old_arena, uint16_t old_size, uint16_t offset);
+static uint16_t find(const char *label, uint8_t length);
+static uint16_t append(const char *label, uint8_t length);
+static uint16_t table_size(uint8_t light_count, uint8_t tag_count);
+
+static uint8_t *arena;
+static uint16_t arena_size;
+static uint16_t pool_size;
+
+void fleet_deinit(void) {
+	if (arena) free(arena);
+	arena = NULL;
+	arena_size = pool_size = 0;
+	lights = tags = NULL;
+	num_lights = num_tags = 0;
+}
+
+bool fleet_resize(uint8_t type, uint8_t num) {
+	uint8_t new_num_lights = type == KEY_TYPE_LIGHT ? num : num_lights;
+	uint8_t new_num_tags = type == KEY_TYPE_TAG ? num : num_tags;
+	if (arena && new_num_lights == num_lights && new_num_tags == num_tags) return true;
+	if (!arena || table_size(new_num_lights, new_num_tags) + pool_size > arena_size) {
+		return rebuild(new_num_lights, new_num_tags, 0);
+	}
+	Light *new_tags = lights + new_num_lights;
+	memmove(new_tags, tags, sizeof(Light) * (new_num_tags < num_tags ? new_num_tags : num_tags));
+	if (new_num_lights > num_lights) memset(&lights[num_lights], 0, sizeof(Light) * (new_num_lights - num_lights));
+	if (new_num_tags > num_tags) memset(&new_tags[num_tags], 0, sizeof(Light) * (new_num_tags - num_tags));
+	tags = new_tags;
+	num_lights = new_num_lights;
+	num_tags = new_num_tags;
+	return true;
+}
+
+uint16_t fleet_intern(uint16_t current, const char *label, uint8_t length) {
+	if (length == 0) return 0;
+	const char *text = fleet_label(current);
+	if (strncmp(text, label, length) == 0 && text[length] == '\0') return current;
+	uint16_t offset = find(label, length);
+	if (offset) return offset;
+	if (!arena || table_size(num_lights, num_tags) + pool_size + length + 1 > arena_size) {
+		if (!rebuild(num_lights, num_tags, length + 1)) return 0;
+	}
+	return append(label, length);
+}
+
+const char* fleet_label(uint16_t offset) {
+	return offset ? (const char*) arena + arena_size - offset : "";
+}
+
+uint16_t fleet_size(void) {
+	return arena_size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static bool rebuild(uint8_t new_num_lights, uint8_t new_num_tags, uint16_t extra) {
+	uint16_t live = extra + (all_lights ? strlen(fleet_label(all_lights->label)) + 1 : 0);
+	for (uint8_t i = 0; i < num_lights; i++) live += strlen(fleet_label(lights[i].label)) + 1;
+	for (uint8_t i = 0; i < num_tags; i++) live += strlen(fleet_label(tags[i].label)) + 1;
+	uint16_t table = table_size(new_num_lights, new_num_tags);
+	uint16_t size = table + live + live / 2 + FLEET_SLACK;
+	uint8_t *new_arena = malloc(size);
+	if (!new_arena) {
+		WARN("fleet: no room for %d bytes", size);
+		return false;
+	}
+	memset(new_arena, 0, table);
+
+	uint8_t *old_arena = arena;
+	uint16_t old_size = arena_size;
+	Light *old_lights = lights;
+	Light *old_tags = tags;
+	uint8_t old_num_lights = num_lights;
+	uint8_t old_num_tags = num_tags;
+
+	arena = new_arena;
+	arena_size = size;
+	pool_size = 0;
+	num_lights = new_num_lights;
+	num_tags = new_num_tags;
+	lights = (Light*) arena;
+	tags = lights + num_lights;
+	if (old_arena) {
+		memcpy(lights, old_lights, sizeof(Light) * (num_lights < old_num_lights ? num_lights : old_num_lights));
+		memcpy(tags, old_tags, sizeof(Light) * (num_tags < old_num_tags ? num_tags : old_num_tags));
+	}
+
+	if (all_lights) all_lights->label = relabel(old_arena, old_size, all_lights->label);
+	for (uint8_t i = 0; i < num_lights; i++) lights[i].label = relabel(old_arena, old_size, lights[i].label);
+	for (uint8_t i = 0; i < num_tags; i++) tags[i].label = relabel(old_arena, old_size, tags[i].label);
+	if (old_arena) free(old_arena);
+
+	LOG("fleet: %d bytes for %d lights and %d tags, %d per entry", arena_size, num_lights, num_tags,
+		num_lights + num_tags ? arena_size / (num_lights + num_tags) : 0);
+	return true;
+}
+
+static uint16_t relabel(const uint8_t *old_arena, uint16_t old_size, uint16_t offset) {
+	if (!offset) return 0;
+	const char *label = (const char*) old_arena + old_size - offset;
+	uint8_t length = strlen(label);
+	uint16_t found = find(label, length);
+	return found ? found : append(label, length);
+}
+
+static uint16_t find(const char *label, uint8_t length) {
+	if (!arena) return 0;
+	const char *end = (const char*) arena + arena_size;
+	for (const char *text = end - pool_size; text < end; text += strlen(text) + 1) {
+		if (strncmp(text, label, length) == 0 && text[length] == '\0') return end - text;
+	}
+	return 0;
+}
+
+static uint16_t append(const char *label, uint8_t length) {
+	pool_size += length + 1;
+	char *text = (char*) arena + arena_size - pool_size;
+	memcpy(text, label, length);
+	text[length] = '\0';
+	return pool_size;
+}
+
+static uint16_t table_size(uint8_t light_count, uint8_t tag_count) {
+	return sizeof(Light) * (light_count + tag_count);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+void fleet_deinit(void);
+bool fleet_resize(uint8_t type, uint8_t num);
+uint16_t fleet_intern(uint16_t current, const char *label, uint8_t length);
+const char* fleet_label(uint16_t offset);
+uint16_t fleet_size(void);
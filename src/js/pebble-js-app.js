@@ -1,44 +1,262 @@
+var PRIORITY = {
+	INTERACTIVE: 0,
+	ERROR: 1,
+	SYNC: 2,
+	BACKGROUND: 3
+};
+
+function RingBuffer() {
+	this.items = new Array(16);
+	this.head = 0;
+	this.length = 0;
+}
+
+RingBuffer.prototype.push = function(item) {
+	if (this.length == this.items.length) {
+		var items = new Array(this.items.length * 2);
+		for (var i = 0; i < this.length; i++) items[i] = this.items[(this.head + i) % this.items.length];
+		this.items = items;
+		this.head = 0;
+	}
+	this.items[(this.head + this.length) % this.items.length] = item;
+	this.length++;
+};
+
+RingBuffer.prototype.shift = function() {
+	if (this.length === 0) return null;
+	var item = this.items[this.head];
+	this.items[this.head] = undefined;
+	this.head = (this.head + 1) % this.items.length;
+	this.length--;
+	return item;
+};
+
+// Takes out every item that passes test, keeping the rest in order, and returns the removed ones.
+RingBuffer.prototype.remove = function(test) {
+	var kept = new RingBuffer(), removed = [];
+	while (this.length > 0) {
+		var item = this.shift();
+		if (test(item)) removed.push(item);
+		else kept.push(item);
+	}
+	this.items = kept.items;
+	this.head = kept.head;
+	this.length = kept.length;
+	return removed;
+};
+
+// One lane per PRIORITY; the next message always comes from the most urgent non-empty lane.
 var appMessageQueue = {
-	queue: [],
+	lanes: [new RingBuffer(), new RingBuffer(), new RingBuffer(), new RingBuffer()],
+	current: null,
 	numTries: 0,
-	maxTries: 5,
 	working: false,
-	clear: function() {
-		this.queue = [];
-		this.working = false;
+	timer: null,
+	// Per nack reason: base delay in ms for the jittered exponential backoff and attempts before giving up.
+	backoff: {
+		busy: {delay:50, maxTries:8},
+		disconnected: {delay:1000, maxTries:4},
+		overflow: {delay:0, maxTries:1},
+		other: {delay:250, maxTries:5}
+	},
+	// Takes waiting messages out of the lanes; their senders hear about it as a failure.
+	drop: function(test) {
+		this.lanes.forEach(function(lane) {
+			lane.remove(function(entry) { return test(entry.message); }).forEach(function(entry) {
+				if (entry.callback) entry.callback(false, 'dropped');
+			});
+		});
 	},
 	isEmpty: function() {
-		return this.queue.length === 0;
+		return !this.current && this.lanes.every(function(lane) { return lane.length === 0; });
 	},
 	nextMessage: function() {
-		return this.isEmpty() ? {} : this.queue[0];
+		return this.current ? this.current.message : {};
+	},
+	take: function() {
+		for (var i = 0; i < this.lanes.length; i++) {
+			if (this.lanes[i].length > 0) return this.lanes[i].shift();
+		}
+		return null;
 	},
-	send: function(message) {
-		if (message) this.queue.push(message);
+	reason: function(e) {
+		var error = e && (e.error || (e.data && e.data.error));
+		var message = error && error.message ? error.message : '';
+		if (/busy/i.test(message)) return 'busy';
+		if (/overflow/i.test(message)) return 'overflow';
+		if (/not.?connected|not.?running|timeout|closed/i.test(message)) return 'disconnected';
+		return 'other';
+	},
+	send: function(message, priority, callback) {
+		if (message) this.lanes[isset(priority) ? priority : PRIORITY.SYNC].push({message:message, callback:callback});
 		if (this.working) return;
-		if (this.queue.length > 0) {
+		if (!this.current) this.current = this.take();
+		if (this.current) {
 			this.working = true;
-			var ack = function() {
+			var entry = this.current;
+			var next = function(success, reason) {
+				if (appMessageQueue.current !== entry) return;
+				if (entry.callback) entry.callback(success, reason);
 				appMessageQueue.numTries = 0;
-				appMessageQueue.queue.shift();
+				appMessageQueue.current = null;
 				appMessageQueue.working = false;
 				appMessageQueue.send();
 			};
-			var nack = function() {
-				appMessageQueue.numTries++;
-				appMessageQueue.working = false;
-				appMessageQueue.send();
+			var ack = function() {
+				next(true);
+			};
+			var nack = function(e) {
+				if (appMessageQueue.current !== entry) return;
+				var reason = appMessageQueue.reason(e);
+				var backoff = appMessageQueue.backoff[reason];
+				if (++appMessageQueue.numTries >= backoff.maxTries) {
+					console.log('Failed sending AppMessage (' + reason + '): ' + JSON.stringify(entry.message));
+					next(false, reason);
+					return;
+				}
+				var delay = backoff.delay * Math.pow(2, appMessageQueue.numTries - 1);
+				delay = delay / 2 + Math.random() * delay / 2;
+				appMessageQueue.timer = setTimeout(function() {
+					appMessageQueue.timer = null;
+					appMessageQueue.working = false;
+					appMessageQueue.send();
+				}, delay);
 			};
-			if (this.numTries >= this.maxTries) {
-				console.log('Failed sending AppMessage: ' + JSON.stringify(this.nextMessage()));
-				ack();
-			}
 			console.log('Sending AppMessage: ' + JSON.stringify(this.nextMessage()));
 			Pebble.sendAppMessage(this.nextMessage(), ack, nack);
 		}
 	}
 };
 
+// HTTP requests to lifx-http: at most maxActive at once, the rest wait in order. A GET for a URL
+// that is already queued or running shares that request instead of making another one.
+var apiQueue = {
+	maxActive: 3,
+	active: 0,
+	waiting: new RingBuffer(),
+	gets: {},
+	depth: function() {
+		return this.active + this.waiting.length;
+	},
+	send: function(method, url, data, cb, fb) {
+		var request = method == 'GET' ? this.gets[url] : null;
+		if (request) {
+			console.log('Sharing ' + method + ' ' + url);
+			request.callbacks.push({cb:cb, fb:fb});
+			return;
+		}
+		request = {method:method, url:url, data:data, callbacks:[{cb:cb, fb:fb}]};
+		if (method == 'GET') this.gets[url] = request;
+		this.waiting.push(request);
+		this.next();
+	},
+	next: function() {
+		while (this.active < this.maxActive && this.waiting.length > 0) {
+			this.start(this.waiting.shift());
+		}
+	},
+	start: function(request) {
+		this.active++;
+		console.log(request.method + ' ' + request.url + ' ' + request.data + ' (' + this.depth() + ' requests)');
+		var xhr = new XMLHttpRequest();
+		var finish = function(success, error) {
+			apiQueue.active--;
+			if (apiQueue.gets[request.url] === request) delete apiQueue.gets[request.url];
+			request.callbacks.forEach(function(callback) {
+				if (success) callback.cb(xhr);
+				else callback.fb(error);
+			});
+			apiQueue.next();
+		};
+		xhr.open(request.method, request.url, true);
+		xhr.onload = function() { finish(true); };
+		xhr.onerror = function() { finish(false, 'Server error!'); };
+		xhr.ontimeout = function() { finish(false, 'Connection to server timed out!'); };
+		xhr.timeout = 30000;
+		xhr.send(request.data);
+	}
+};
+
+// Paces commands to what the bulbs can take. Every bulb has a token bucket; a command spends one
+// token from each bulb its selector reaches, so a tag or all-lights command costs as many tokens as
+// it has bulbs. A command that has to wait takes the place of an earlier waiting one for the same
+// selector and setting (latest wins) and answers both. Toggles are never merged.
+var rateLimiter = {
+	rate: 20,
+	burst: 10,
+	buckets: {},
+	waiting: [],
+	timer: null,
+
+	key: function(request) {
+		if (request.endpoint == '/toggle') return null;
+		var setting = request.endpoint == '/on' || request.endpoint == '/off' ? '/power' : request.endpoint;
+		return request.selector + setting;
+	},
+
+	bulbs: function(selector) {
+		if (selector == 'all') return LIFX.lights.map(function(light) { return light.id; });
+		if (selector.substring(0, 4) == 'tag:') {
+			var members = fleetIndex.members[selector.substring(4)];
+			return members ? Object.keys(members.lights).map(function(i) { return LIFX.lights[i].id; }) : [];
+		}
+		return [selector];
+	},
+
+	bucket: function(bulb, now) {
+		var bucket = this.buckets[bulb] || (this.buckets[bulb] = {tokens:this.burst, time:now});
+		bucket.tokens = Math.min(this.burst, bucket.tokens + (now - bucket.time) * this.rate / 1000);
+		bucket.time = now;
+		return bucket;
+	},
+
+	send: function(method, endpoint, data, cb, fb, selector) {
+		var request = {method:method, endpoint:endpoint, data:data, selector:selector, callbacks:[{cb:cb, fb:fb}]};
+		var key = this.key(request);
+		for (var i = 0; key && i < this.waiting.length; i++) {
+			var waiting = this.waiting[i];
+			if (this.key(waiting) !== key) continue;
+			console.log('Merging ' + method + ' ' + endpoint + ' for ' + selector);
+			waiting.endpoint = endpoint;
+			waiting.data = data;
+			waiting.callbacks.push(request.callbacks[0]);
+			return;
+		}
+		this.waiting.push(request);
+		this.next();
+	},
+
+	// Starts every waiting command whose bulbs all have a token and waits for the first refill otherwise.
+	next: function() {
+		clearTimeout(this.timer);
+		this.timer = null;
+		var now = Date.now(), wait = Infinity;
+		this.waiting = this.waiting.filter(function(request) {
+			var buckets = this.bulbs(request.selector).map(function(bulb) { return this.bucket(bulb, now); }, this);
+			var empty = buckets.filter(function(bucket) { return bucket.tokens < 1; });
+			if (empty.length > 0) {
+				empty.forEach(function(bucket) { wait = Math.min(wait, (1 - bucket.tokens) * 1000 / this.rate); }, this);
+				return true;
+			}
+			buckets.forEach(function(bucket) { bucket.tokens--; });
+			this.start(request);
+			return false;
+		}, this);
+		if (wait < Infinity) this.timer = setTimeout(this.next.bind(this), Math.ceil(wait));
+	},
+
+	start: function(request) {
+		var url = LIFX.server + '/lights/' + encodeURIComponent(request.selector) + request.endpoint;
+		apiQueue.send(request.method, url, request.data, function(xhr) {
+			request.callbacks.forEach(function(callback) { callback.cb(xhr); });
+		}, function(error) {
+			request.callbacks.forEach(function(callback) { callback.fb(error); });
+		});
+	}
+};
+
+var PROTOCOL = 1;
+
 var TYPE = {
 	ERROR: 0,
 	LIGHT: 1,
@@ -53,16 +271,262 @@ var METHOD = {
 	REFRESH: 3,
 	TOGGLE: 4,
 	COLOR: 5,
-	READY: 6
+	READY: 6,
+	PATCH: 7,
+	SCENE_SAVE: 8,
+	SCENE_RESTORE: 9,
+	PALETTE: 10
+};
+
+// Packed record: index, flags, hue, saturation, brightness, kelvin (LE), label length, label.
+// Indexes and counts are single bytes on the watch, so a list holds at most MAX_COUNT entries.
+var RECORD = {
+	FLAG_ON: 0x01,
+	MAX_LABEL: 17,
+	MAX_COUNT: 255
+};
+
+var appMessageSize = {
+	// Dictionary header plus a 7 byte header per tuple; PebbleKit JS sends numbers as 4 byte ints.
+	header: 1,
+	tuple: function(value) {
+		if (typeof value == 'string') return 7 + unescape(encodeURIComponent(value)).length + 1;
+		if (value instanceof Array) return 7 + value.length;
+		return 7 + 4;
+	},
+	tuples: function(dict) {
+		var size = 0;
+		for (var key in dict) size += this.tuple(dict[key]);
+		return size;
+	}
+};
+
+// Lookups kept in step with LIFX.lights and LIFX.tags, so handling a response never scans the lists.
+// A light's tags are read from its own tags array before it is replaced.
+var fleetIndex = {
+	ids: {},
+	tags: {},
+	members: {},
+
+	// Tags are listed in order of first appearance, each with the color of its first member.
+	build: function() {
+		this.ids = {};
+		this.tags = {};
+		this.members = {};
+		LIFX.tags = [];
+		for (var i = 0; i < LIFX.lights.length; i++) {
+			this.ids[LIFX.lights[i].id] = i;
+			this.join(i, LIFX.lights[i], null);
+		}
+	},
+
+	position: function(id) {
+		return this.ids.hasOwnProperty(id) ? this.ids[id] : -1;
+	},
+
+	// Swaps in a fresh copy of a known light and returns whether the tag list changed.
+	replace: function(light) {
+		var i = this.position(light.id);
+		if (i < 0) return false;
+		var previous = LIFX.lights[i];
+		LIFX.lights[i] = light;
+		var changed = false;
+		if (previous.tags !== light.tags && (previous.tags || []).join() !== (light.tags || []).join()) {
+			changed = this.leave(i, previous, light);
+			changed = this.join(i, light, previous) || changed;
+		}
+		return changed;
+	},
+
+	join: function(i, light, except) {
+		var changed = false;
+		(light.tags || []).forEach(function(tag) {
+			if (tag.substring(0,1) == '_' || (except && except.tags && except.tags.indexOf(tag) >= 0)) return;
+			var members = this.members[tag];
+			if (!members) {
+				members = this.members[tag] = {count:0, lights:{}};
+				this.tags[tag] = LIFX.tags.length;
+				LIFX.tags.push({label:tag, color:light.color});
+				changed = true;
+			}
+			if (!members.lights[i]) {
+				members.lights[i] = true;
+				members.count++;
+			}
+		}, this);
+		return changed;
+	},
+
+	leave: function(i, light, except) {
+		var changed = false;
+		(light.tags || []).forEach(function(tag) {
+			var members = this.members[tag];
+			if (!members || !members.lights[i] || (except && except.tags && except.tags.indexOf(tag) >= 0)) return;
+			delete members.lights[i];
+			if (--members.count > 0) return;
+			var position = this.tags[tag];
+			delete this.members[tag];
+			delete this.tags[tag];
+			LIFX.tags.splice(position, 1);
+			for (var j = position; j < LIFX.tags.length; j++) this.tags[LIFX.tags[j].label] = j;
+			changed = true;
+		}, this);
+		return changed;
+	}
+};
+
+// Picks up changes made elsewhere (wall switches, other apps). Polls every few seconds after the
+// user did something on the watch, backs off while idle and stops once the watch can't be reached.
+var poller = {
+	fast: 5000,
+	slow: 60000,
+	idleAfter: 30000,
+	delay: 0,
+	lastInteraction: 0,
+	running: false,
+	timer: null,
+	start: function() {
+		this.interact();
+	},
+	stop: function() {
+		this.running = false;
+		clearTimeout(this.timer);
+		this.timer = null;
+	},
+	// Any command from the watch shows it's reachable again, so this also restarts a stopped poller.
+	interact: function() {
+		this.running = true;
+		this.lastInteraction = Date.now();
+		this.delay = this.fast;
+		this.schedule();
+	},
+	schedule: function() {
+		clearTimeout(this.timer);
+		this.timer = null;
+		if (this.running) this.timer = setTimeout(this.tick.bind(this), this.delay);
+	},
+	tick: function() {
+		if (Date.now() - this.lastInteraction > this.idleAfter) this.delay = Math.min(this.delay * 2, this.slow);
+		LIFX.poll();
+		this.schedule();
+	}
+};
+
+// Snapshots of whole tags or the fleet by watch slot, one [id, on, hue, saturation, brightness, kelvin]
+// per light in lifx-http's units. A restore is queued in one go so apiQueue fans it out, skipping
+// lights that already match, and the watch gets a single sync once every light has answered.
+var scenes = {
+	slots: JSON.parse(localStorage.getItem('scenes') || '{}'),
+
+	members: function(type, index) {
+		switch (type) {
+			case TYPE.LIGHT:
+				return LIFX.lights[index] ? [LIFX.lights[index]] : [];
+			case TYPE.TAG:
+				var members = LIFX.tags[index] ? fleetIndex.members[LIFX.tags[index].label] : null;
+				return members ? Object.keys(members.lights).map(function(i) { return LIFX.lights[i]; }) : [];
+			default:
+				return LIFX.lights;
+		}
+	},
+
+	save: function(slot, type, index) {
+		this.slots[slot] = this.members(type, index).map(function(light) {
+			var color = light.color || {};
+			return [light.id, light.on ? 1 : 0, color.hue, color.saturation, color.brightness, color.kelvin];
+		});
+		localStorage.setItem('scenes', JSON.stringify(this.slots));
+		console.log('Saved scene ' + slot + ' with ' + this.slots[slot].length + ' lights');
+	},
+
+	// Compared in the watch's units, so rounding in lifx-http doesn't count as a change.
+	matches: function(light, entry) {
+		if (!!light.on != !!entry[1]) return false;
+		if (!entry[1]) return true;
+		var color = light.color || {}, colors = LIFX.colors;
+		return colors.hue.serialize(color.hue) == colors.hue.serialize(entry[2])
+			&& colors.saturation.serialize(color.saturation) == colors.saturation.serialize(entry[3])
+			&& colors.brightness.serialize(color.brightness) == colors.brightness.serialize(entry[4])
+			&& color.kelvin == entry[5];
+	},
+
+	restore: function(slot) {
+		if (!this.slots[slot]) {
+			LIFX.error('Scene not found on this phone!');
+			return;
+		}
+		var entries = this.slots[slot].filter(function(entry) {
+			var i = fleetIndex.position(entry[0]);
+			return i >= 0 && !this.matches(LIFX.lights[i], entry);
+		}, this);
+		var remaining = entries.length, updated = [], failure = null;
+		var done = function() {
+			if (--remaining > 0) return;
+			if (failure) LIFX.error(failure);
+			LIFX.update(updated);
+		};
+		var collect = function(xhr) {
+			try {
+				Array.prototype.push.apply(updated, [].concat(JSON.parse(xhr.responseText)));
+			} catch(e) {
+				failure = 'Error handling response from server!';
+			}
+			done();
+		};
+		var fail = function(error) {
+			failure = error;
+			done();
+		};
+		console.log('Restoring scene ' + slot + ': ' + entries.length + ' lights to change');
+		entries.forEach(function(entry) {
+			if (!entry[1]) {
+				LIFX.makeAPIRequest('PUT', '/off', null, collect, fail, entry[0]);
+				return;
+			}
+			// Color first so a light that was off doesn't flash its old color.
+			var color = {hue:entry[2], saturation:entry[3], brightness:entry[4], kelvin:entry[5]};
+			var on = LIFX.lights[fleetIndex.position(entry[0])].on;
+			LIFX.makeAPIRequest('PUT', '/color', JSON.stringify(color), on ? collect : function() {
+				LIFX.makeAPIRequest('PUT', '/on', null, collect, fail, entry[0]);
+			}, fail, entry[0]);
+		});
+	}
+};
+
+// Mirror of the watch's custom colors as [hue, saturation, brightness, kelvin] in watch units. The
+// watch owns them and sends each change; they only come back to a watch that reports none.
+var palette = {
+	colors: JSON.parse(localStorage.getItem('palette') || '[]'),
+
+	change: function(added, color) {
+		var key = color.join();
+		this.colors = this.colors.filter(function(saved) { return saved.join() != key; });
+		if (added) this.colors.unshift(color);
+		localStorage.setItem('palette', JSON.stringify(this.colors));
+	},
+
+	restore: function(count) {
+		if (count !== 0) return;
+		// Oldest first, since the watch puts each new color on top.
+		this.colors.slice().reverse().forEach(function(color) {
+			appMessageQueue.send({method:METHOD.PALETTE, state:1, color_h:color[0], color_s:color[1], color_b:color[2], color_k:color[3]}, PRIORITY.BACKGROUND);
+		});
+	}
 };
 
 var LIFX = {
 	server: localStorage.getItem('server') || 'http://lifx-http.local:56780',
+	inboxSize: parseInt(localStorage.getItem('inboxSize'), 10) || 124,
 	lights: [],
 	tags: [],
-	type: null,
+	// Records per type the watch has acknowledged, and those queued for it; syncs are deltas against the latter.
+	acked: {},
+	queued: {},
+	// Fleet version the watch reported for its cache in READY; nothing is synced before that.
+	watchVersion: 0,
+	watchReady: false,
+	session: null,
 	method: null,
-	index: 0,
 
 	colors: {
 		makePostData: function(hue, saturation, brightness, kelvin) {
@@ -86,169 +550,420 @@ var LIFX = {
 		}
 	},
 
-	error: function(error) {
-		appMessageQueue.clear();
-		appMessageQueue.send({type:TYPE.ERROR, label:error});
+	// An operation id tells the watch which optimistic change to roll back. Only that operation's
+	// waiting messages are dropped; confirmations for other operations still go out.
+	error: function(error, operation) {
+		var message = {type:TYPE.ERROR, label:error};
+		if (isset(operation)) {
+			message.operation = operation;
+			appMessageQueue.drop(function(queued) { return queued.operation === operation; });
+		}
+		appMessageQueue.send(message, PRIORITY.ERROR);
 	},
 
-	getSelector: function() {
-		switch (this.type) {
+	getSelector: function(type, index) {
+		switch (type) {
 			default:
 			case TYPE.ALL:
 				return 'all';
 			case TYPE.LIGHT:
-				return this.lights[this.index].id;
+				return this.lights[index] ? this.lights[index].id : null;
 			case TYPE.TAG:
-				return 'tag:' + this.tags[this.index].label;
+				return this.tags[index] ? 'tag:' + this.tags[index].label : null;
 		}
 	},
 
-	sendLight: function(index) {
-		var label = this.lights[index].label ? this.lights[index].label.substring(0,18) : this.lights[index].id;
-		var state = this.lights[index].on ? 'ON' : 'OFF';
+	// Everything the response to a watch command needs, so several can be in flight at once.
+	context: function(type, index, operation) {
+		return {type:type, selector:this.getSelector(type, index), operation:operation};
+	},
+
+	makeRecord: function(index, item, flags) {
+		var label = utf8Bytes(item.label || item.id || '', RECORD.MAX_LABEL);
 		var color_h = 50, color_s = 100, color_b = 100, color_k = 3000;
-		if (this.lights[index].color) {
-			color_h = LIFX.colors.hue.serialize(this.lights[index].color.hue);
-			color_s = LIFX.colors.saturation.serialize(this.lights[index].color.saturation);
-			color_b = LIFX.colors.brightness.serialize(this.lights[index].color.brightness);
-			color_k = LIFX.colors.kelvin.serialize(this.lights[index].color.kelvin);
+		if (item.color) {
+			color_h = LIFX.colors.hue.serialize(item.color.hue);
+			color_s = LIFX.colors.saturation.serialize(item.color.saturation);
+			color_b = LIFX.colors.brightness.serialize(item.color.brightness);
+			color_k = LIFX.colors.kelvin.serialize(item.color.kelvin);
 		}
-		appMessageQueue.send({type:TYPE.LIGHT, method:METHOD.DATA, index:index, label:label, state:state, color_h:color_h, color_s:color_s, color_b:color_b, color_k:color_k});
+		return [index, flags, color_h, color_s, color_b, color_k & 0xff, (color_k >> 8) & 0xff, label.length].concat(label);
 	},
 
-	sendLights: function() {
-		appMessageQueue.send({type:TYPE.LIGHT, method:METHOD.BEGIN, index:LIFX.lights.length});
-		for (var i = 0; i < LIFX.lights.length; i++) {
-			this.sendLight(i);
+	lightRecord: function(index) {
+		return this.makeRecord(index, this.lights[index], this.lights[index].on ? RECORD.FLAG_ON : 0);
+	},
+
+	tagRecord: function(index) {
+		return this.makeRecord(index, this.tags[index], 0);
+	},
+
+	sendPatch: function(type, count, records, version, priority, operation) {
+		var message = null, size = 0;
+		// The version and operation ride on the last message, so every message leaves room for them.
+		var trailer = appMessageSize.tuple(version) + (isset(operation) ? appMessageSize.tuple(operation) : 0);
+		var send = function() {
+			var sent = message;
+			appMessageQueue.send(message, priority, function(success, reason) {
+				LIFX.ack(type, sent, success);
+				if (reason == 'disconnected') poller.stop();
+				if (reason == 'overflow') {
+					// The watch inbox is smaller than we thought; pack less and try again.
+					LIFX.inboxSize = Math.max(124, Math.floor(LIFX.inboxSize * 3 / 4));
+					LIFX.sync(type, PRIORITY.SYNC, false);
+				}
+			});
+			message = null;
+		};
+		records.forEach(function(record) {
+			if (message && size + record.length > LIFX.inboxSize) send();
+			if (!message) {
+				message = {type:type, method:METHOD.PATCH, index:count, count:0, data:[]};
+				size = appMessageSize.header + appMessageSize.tuples(message) + trailer;
+			}
+			Array.prototype.push.apply(message.data, record);
+			message.count++;
+			size += record.length;
+		});
+		if (!message && records.length === 0) {
+			message = {type:type, method:METHOD.PATCH, index:count, count:0};
 		}
-		appMessageQueue.send({type:TYPE.LIGHT, method:METHOD.END});
-	},
-
-	sendTags: function() {
-		appMessageQueue.send({type:TYPE.TAG, method:METHOD.BEGIN, index:LIFX.tags.length});
-		for (var i = 0; i < LIFX.tags.length; i++) {
-			var label = this.tags[i].label ? this.tags[i].label.substring(0,18) : '';
-			var color_h = 50, color_s = 100, color_b = 100, color_k = 3000;
-			if (LIFX.tags[i].color) {
-				color_h = LIFX.colors.hue.serialize(LIFX.tags[i].color.hue);
-				color_s = LIFX.colors.saturation.serialize(LIFX.tags[i].color.saturation);
-				color_b = LIFX.colors.brightness.serialize(LIFX.tags[i].color.brightness);
-				color_k = LIFX.colors.kelvin.serialize(LIFX.tags[i].color.kelvin);
+		message.version = version;
+		if (isset(operation)) message.operation = operation;
+		send();
+	},
+
+	snapshot: function(snapshots, type, copy) {
+		var snapshot = snapshots[type] || (snapshots[type] = {count:0, records:[]});
+		return copy ? {count:snapshot.count, records:snapshot.records.slice()} : snapshot;
+	},
+
+	ack: function(type, message, success) {
+		var acked = this.snapshot(this.acked, type);
+		var queued = this.snapshot(this.queued, type);
+		var resync = false;
+		for (var i = 0, offset = 0; i < message.count; i++, offset += record.length) {
+			var record = this.decodeRecord(message.data, offset);
+			if (!success) {
+				queued.records[record.index] = acked.records[record.index];
+				continue;
+			}
+			// A newer record for this index overtook this one in a more urgent lane and the watch now has stale data.
+			if (acked.records[record.index] === queued.records[record.index] && queued.records[record.index] !== record.key) {
+				queued.records[record.index] = record.key;
+				resync = true;
 			}
-			appMessageQueue.send({type:TYPE.TAG, method:METHOD.DATA, index:i, label:label, color_h:color_h, color_s:color_s, color_b:color_b, color_k:color_k});
+			acked.records[record.index] = record.key;
+		}
+		if (!success) return;
+		acked.count = message.index;
+		acked.records.length = Math.min(acked.records.length, message.index);
+		if (resync) this.sync(type, PRIORITY.SYNC);
+	},
+
+	// Decodes the record starting at offset; its length gives where the next one starts.
+	decodeRecord: function(data, offset) {
+		var length = 8 + data[offset + 7];
+		return {index:data[offset], length:length, key:data.slice(offset, offset + length).join(',')};
+	},
+
+	records: function(type) {
+		var records = [];
+		var list = type == TYPE.LIGHT ? this.lights : this.tags;
+		if (list.length > RECORD.MAX_COUNT) console.log('Only the first ' + RECORD.MAX_COUNT + ' of ' + list.length + ' fit on the watch');
+		for (var i = 0; i < list.length && i < RECORD.MAX_COUNT; i++) {
+			records.push(type == TYPE.LIGHT ? this.lightRecord(i) : this.tagRecord(i));
 		}
-		appMessageQueue.send({type:TYPE.TAG, method:METHOD.END});
+		return records;
+	},
+
+	// FNV-1a over every light and tag record, kept positive so it survives the trip as an int32.
+	version: function() {
+		var hash = 2166136261;
+		this.records(TYPE.LIGHT).concat(this.records(TYPE.TAG)).forEach(function(record) {
+			for (var i = 0; i < record.length; i++) {
+				hash = (hash ^ record[i]) >>> 0;
+				hash = (hash + (hash << 1) + (hash << 4) + (hash << 7) + (hash << 8) + (hash << 24)) >>> 0;
+			}
+		});
+		return (hash & 0x7fffffff) || 1;
+	},
+
+	// Unless forced, a sync without changes sends nothing; otherwise it sends at least one (empty) PATCH.
+	sync: function(type, priority, force, operation) {
+		if (!this.watchReady) return;
+		var records = this.records(type);
+		var version = this.version();
+		if (!this.acked[type] && this.watchVersion === version) {
+			console.log('Sync: watch cache is current');
+			this.acked[type] = {count:records.length, records:records.map(function(record) { return record.join(','); })};
+			this.queued[type] = this.snapshot(this.acked, type, true);
+		}
+		var queued = this.snapshot(this.queued, type);
+		var changed = records.filter(function(record) {
+			return queued.records[record[0]] !== record.join(',');
+		});
+		if (changed.length === 0 && queued.count === records.length) {
+			console.log('Sync: no changes');
+			if (!force) return;
+		}
+		changed.forEach(function(record) {
+			queued.records[record[0]] = record.join(',');
+		});
+		queued.count = records.length;
+		queued.records.length = Math.min(queued.records.length, records.length);
+		this.sendPatch(type, records.length, changed, version, priority, operation);
+	},
+
+	syncLights: function(priority, operation) {
+		this.sync(TYPE.LIGHT, priority, true, operation);
+	},
+
+	// The watch already shows the expected state for these lights; resend them so it can compare.
+	touch: function(lights) {
+		var queued = this.snapshot(this.queued, TYPE.LIGHT);
+		lights.forEach(function(light) {
+			var i = fleetIndex.position(light.id);
+			if (i >= 0) delete queued.records[i];
+		});
+	},
+
+	syncTags: function(priority) {
+		this.sync(TYPE.TAG, priority, false);
 	},
 
-	handleResponse: function(xhr) {
+	// Keeps a trimmed copy of the fleet so the next launch can show it before lifx-http answers.
+	save: function() {
+		var trim = function(color) {
+			return color ? {hue:color.hue, saturation:color.saturation, brightness:color.brightness, kelvin:color.kelvin} : null;
+		};
+		var fleet = {
+			lights: this.lights.map(function(light) { return {id:light.id, label:light.label, on:light.on, color:trim(light.color), tags:light.tags}; })
+		};
+		localStorage.setItem('fleet', JSON.stringify(fleet));
+	},
+
+	restore: function() {
+		try {
+			var fleet = JSON.parse(localStorage.getItem('fleet'));
+			if (!fleet) return;
+			this.lights = fleet.lights;
+			fleetIndex.build();
+			console.log('Restored ' + this.lights.length + ' lights and ' + this.tags.length + ' tags');
+		} catch(e) {
+			localStorage.removeItem('fleet');
+		}
+	},
+
+	handleResponse: function(xhr, context) {
 		try {
 			var res = JSON.parse(xhr.responseText);
 			console.log(JSON.stringify(res));
-			switch (LIFX.type) {
-				case TYPE.ALL: {
-					LIFX.lights = res;
-					LIFX.sendLights();
-					if (LIFX.tags.length > 0) break;
-					LIFX.tags = [];
-					LIFX.lights.forEach(function(light) {
-						light.tags.forEach(function(tag) {
-							if (tag.substring(0,1) == '_') return;
-							for (var i = 0; i < LIFX.tags.length; i++) {
-								if (LIFX.tags[i].label == tag) return;
-							}
-							LIFX.tags.push({label:tag, color:light.color});
-						});
-					});
-					LIFX.sendTags();
-					break;
-				}
-				case TYPE.TAG: {
-					res.forEach(function(light) {
-						for (var i = 0; i < LIFX.lights.length; i++) {
-							if (LIFX.lights[i].id == light.id) {
-								LIFX.lights[i] = light;
-								LIFX.sendLight(i);
-							}
-						}
-					});
-					appMessageQueue.send({type:TYPE.LIGHT, method:METHOD.END});
+			switch (context.type) {
+				case TYPE.ALL:
+					LIFX.replaceFleet([].concat(res), PRIORITY.SYNC, true);
 					break;
-				}
-				case TYPE.LIGHT: {
-					for (var i = 0; i < LIFX.lights.length; i++) {
-						if (LIFX.lights[i].id == res.id) {
-							LIFX.lights[i] = res;
-							LIFX.sendLight(i);
-						}
-					}
-					appMessageQueue.send({type:TYPE.LIGHT, method:METHOD.END});
+				case TYPE.TAG:
+				case TYPE.LIGHT:
+					LIFX.update([].concat(res), context.operation);
 					break;
-				}
 			}
 		} catch(e) {
 			console.log(JSON.stringify(e));
-			appMessageQueue.send({type:TYPE.ERROR, label:'Error handling response from server!'});
+			var message = {type:TYPE.ERROR, label:'Error handling response from server!'};
+			if (isset(context.operation)) message.operation = context.operation;
+			appMessageQueue.send(message, PRIORITY.ERROR);
 		}
 	},
 
-	color: function(hue, saturation, brightness, kelvin) {
-		var data = JSON.stringify(this.colors.makePostData(hue, saturation, brightness, kelvin));
-		this.makeAPIRequest('PUT', '/color', data, this.handleResponse, this.error);
-		setTimeout(function() {
-			LIFX.makeAPIRequest('GET', '', null, LIFX.handleResponse, LIFX.error);
-		}, 2000);
+	// A forced sync answers the watch even when nothing changed, which clears its stale marker.
+	replaceFleet: function(lights, priority, force) {
+		this.lights = lights;
+		fleetIndex.build();
+		this.save();
+		this.sync(TYPE.LIGHT, priority, force);
+		this.syncTags(priority);
 	},
 
-	toggle: function() {
-		this.makeAPIRequest('PUT', '/toggle', null, this.handleResponse, this.error);
+	// Replaces the given lights in the model and sends the watch whatever changed.
+	update: function(lights, operation) {
+		var tagsChanged = false;
+		for (var i = 0; i < lights.length; i++) {
+			if (fleetIndex.replace(lights[i])) tagsChanged = true;
+		}
+		LIFX.save();
+		// Only an operation needs an answer when nothing changed.
+		if (isset(operation)) LIFX.touch(lights);
+		LIFX.sync(TYPE.LIGHT, PRIORITY.INTERACTIVE, isset(operation), operation);
+		if (tagsChanged) LIFX.syncTags(PRIORITY.SYNC);
+	},
+
+	// Per selector: at most one color PUT in flight and only the newest color waiting behind it.
+	pendingColors: {},
+
+	// Bulbs may still report the old color right after a PUT; poll that selector until they match.
+	convergence: {delay:250, maxTries:4},
+
+	color: function(context, hue, saturation, brightness, kelvin) {
+		var selector = context.selector;
+		var pending = this.pendingColors[selector] || (this.pendingColors[selector] = {color:null, operation:undefined, busy:false, timer:null, generation:0});
+		pending.color = this.colors.makePostData(hue, saturation, brightness, kelvin);
+		pending.operation = context.operation;
+		if (!pending.busy) this.putColor(selector, pending);
+	},
+
+	putColor: function(selector, pending) {
+		var color = pending.color;
+		var operation = pending.operation;
+		var generation = ++pending.generation;
+		pending.color = null;
+		pending.busy = true;
+		clearTimeout(pending.timer);
+		var done = function() {
+			pending.busy = false;
+			if (pending.color) LIFX.putColor(selector, pending);
+		};
+		this.makeAPIRequest('PUT', '/color', JSON.stringify(color), function(xhr) {
+			done();
+			LIFX.converge(selector, pending, generation, color, operation, xhr, 0);
+		}, function(error) { LIFX.error(error, operation); done(); }, selector);
+	},
+
+	// The operation is only answered once the bulbs agree (or we give up), so the watch
+	// doesn't report a lagging read as somebody else's change.
+	converge: function(selector, pending, generation, color, operation, xhr, tries) {
+		try {
+			var lights = [].concat(JSON.parse(xhr.responseText));
+		} catch(e) {
+			LIFX.error('Error handling response from server!', operation);
+			return;
+		}
+		var close = function(a, b) { return Math.abs(a - b) <= 1; };
+		var settled = pending.generation != generation || tries + 1 >= this.convergence.maxTries || lights.every(function(light) {
+			return !light.color
+				|| close(LIFX.colors.hue.serialize(light.color.hue), LIFX.colors.hue.serialize(color.hue))
+				&& close(LIFX.colors.saturation.serialize(light.color.saturation), LIFX.colors.saturation.serialize(color.saturation))
+				&& close(LIFX.colors.brightness.serialize(light.color.brightness), LIFX.colors.brightness.serialize(color.brightness))
+				&& close(light.color.kelvin, color.kelvin);
+		});
+		this.update(lights, settled ? operation : undefined);
+		if (settled) return;
+		pending.timer = setTimeout(function() {
+			LIFX.makeAPIRequest('GET', '', null, function(xhr) {
+				LIFX.converge(selector, pending, generation, color, operation, xhr, tries + 1);
+			}, function() { LIFX.update(lights, operation); }, selector);
+		}, this.convergence.delay * Math.pow(2, tries));
 	},
 
-	on: function() {
-		this.makeAPIRequest('PUT', '/on', null, this.handleResponse, this.error);
+	toggle: function(context) {
+		this.command('PUT', '/toggle', context);
 	},
 
-	off: function() {
-		this.makeAPIRequest('PUT', '/off', null, this.handleResponse, this.error);
+	on: function(context) {
+		this.command('PUT', '/on', context);
+	},
+
+	off: function(context) {
+		this.command('PUT', '/off', context);
+	},
+
+	command: function(method, endpoint, context) {
+		this.makeAPIRequest(method, endpoint, null, function(xhr) { LIFX.handleResponse(xhr, context); }, function(error) { LIFX.error(error, context.operation); }, context.selector);
+	},
+
+	polling: false,
+
+	// Background polls only send the watch what changed, so a quiet fleet costs one HTTP call.
+	poll: function() {
+		// Don't add to a backlog the user is already waiting on.
+		if (this.polling || !this.watchReady || apiQueue.depth() > 0 || rateLimiter.waiting.length > 0) return;
+		this.polling = true;
+		this.makeAPIRequest('GET', '', null, function(xhr) {
+			LIFX.polling = false;
+			try {
+				LIFX.replaceFleet(JSON.parse(xhr.responseText), PRIORITY.BACKGROUND, false);
+			} catch(e) {
+				console.log('Poll failed: ' + e);
+			}
+		}, function(error) {
+			LIFX.polling = false;
+			console.log('Poll failed: ' + error);
+		}, 'all');
 	},
 
 	refresh: function() {
-		this.type = TYPE.ALL;
-		this.makeAPIRequest('GET', '', null, this.handleResponse, this.error);
+		this.command('GET', '', this.context(TYPE.ALL));
 	},
 
-	makeAPIRequest: function(method, endpoint, data, cb, fb) {
-		var url = this.server + '/lights/' + encodeURIComponent(this.getSelector()) + endpoint;
-		console.log(method + ' ' + url + ' ' + data);
-		var xhr = new XMLHttpRequest();
-		xhr.open(method, url, true);
-		xhr.onload = function() { cb(xhr); };
-		xhr.onerror = function() { fb('Server error!'); };
-		xhr.ontimeout = function() { fb('Connection to server timed out!'); };
-		xhr.timeout = 30000;
-		xhr.send(data);
+	// Reads go straight to lifx-http; commands are paced per bulb first.
+	makeAPIRequest: function(method, endpoint, data, cb, fb, selector) {
+		if (method != 'GET') {
+			rateLimiter.send(method, endpoint, data, cb, fb, selector);
+			return;
+		}
+		var url = this.server + '/lights/' + encodeURIComponent(selector) + endpoint;
+		apiQueue.send(method, url, data, cb, fb);
 	}
 };
 
 Pebble.addEventListener('ready', function(e) {
+	LIFX.restore();
 	LIFX.refresh();
+	appMessageQueue.send({method:METHOD.READY, protocol:PROTOCOL}, PRIORITY.INTERACTIVE);
 });
 
 Pebble.addEventListener('appmessage', function(e) {
 	console.log('AppMessage received: ' + JSON.stringify(e.payload));
 	if (!isset(e.payload.method)) return;
 	switch (e.payload.method) {
+		case METHOD.READY:
+			// Retries of the same handshake must not trigger another sync.
+			if (e.payload.session === LIFX.session) break;
+			LIFX.session = e.payload.session;
+			console.log('Watch ready: protocol ' + e.payload.protocol + ', inbox ' + e.payload.inbox_size + ', outbox ' + e.payload.outbox_size + ', cache ' + e.payload.version);
+			if (e.payload.protocol !== PROTOCOL) {
+				LIFX.error('Watch and phone app versions differ! Please reinstall OpalX.');
+				break;
+			}
+			LIFX.acked = {};
+			LIFX.queued = {};
+			LIFX.watchVersion = e.payload.version || 0;
+			LIFX.watchReady = true;
+			if (e.payload.inbox_size) {
+				LIFX.inboxSize = e.payload.inbox_size;
+				localStorage.setItem('inboxSize', LIFX.inboxSize);
+			}
+			if (LIFX.lights.length > 0) {
+				LIFX.syncLights(PRIORITY.SYNC);
+				LIFX.syncTags(PRIORITY.SYNC);
+			}
+			palette.restore(e.payload.palette);
+			poller.start();
+			break;
 		case METHOD.REFRESH:
+			poller.interact();
 			LIFX.refresh();
 			break;
 		case METHOD.TOGGLE:
-			LIFX.type = e.payload.type;
-			LIFX.index = e.payload.index;
-			LIFX.toggle();
-			break;
 		case METHOD.COLOR:
-			LIFX.type = e.payload.type;
-			LIFX.index = e.payload.index;
-			LIFX.color(e.payload.color_h, e.payload.color_s, e.payload.color_b, e.payload.color_k);
+			poller.interact();
+			var context = LIFX.context(e.payload.type, e.payload.index, e.payload.operation);
+			if (!context.selector) {
+				LIFX.error('Light not found! Please refresh.', context.operation);
+				break;
+			}
+			if (e.payload.method == METHOD.TOGGLE) LIFX.toggle(context);
+			else LIFX.color(context, e.payload.color_h, e.payload.color_s, e.payload.color_b, e.payload.color_k);
+			break;
+		case METHOD.SCENE_SAVE:
+			scenes.save(e.payload.scene, e.payload.type, e.payload.index);
+			break;
+		case METHOD.PALETTE:
+			palette.change(!!e.payload.state, [e.payload.color_h, e.payload.color_s, e.payload.color_b, e.payload.color_k]);
+			break;
+		case METHOD.SCENE_RESTORE:
+			poller.interact();
+			scenes.restore(e.payload.scene);
 			break;
 	}
 });
@@ -274,3 +989,13 @@ Pebble.addEventListener('webviewclosed', function(e) {
 function isset(i) {
 	return (typeof i != 'undefined');
 }
+
+function utf8Bytes(str, max) {
+	var utf8 = unescape(encodeURIComponent(str));
+	var len = Math.min(utf8.length, max);
+	// Don't cut a multi-byte sequence in half.
+	if (len < utf8.length) while (len > 0 && (utf8.charCodeAt(len) & 0xc0) == 0x80) len--;
+	var bytes = [];
+	for (var i = 0; i < len; i++) bytes.push(utf8.charCodeAt(i));
+	return bytes;
+}
@@ -2,11 +2,52 @@
 #include "light.h"
 #include "libs/pebble-assist.h"
 #include "common.h"
-#include "settings.h"
+#include "operation.h"
+#include "fleet.h"
+#include "palette.h"
 #include "windows/lightlist.h"
+#include "windows/lightmenu.h"
+#include "windows/menu_window.h"
+
+static void patch_records(DictionaryIterator *iter, uint8_t type);
+static void send_ready(void *data);
+static void retry_ready(void);
+static void send_pending(void);
+static void write_toggle(DictionaryIterator *iter);
+static void write_color(DictionaryIterator *iter);
+static void set_error(const char *text);
+static uint16_t write_record(uint8_t *record, uint8_t type, uint8_t index);
+
+#define READY_RETRY_MIN 250
+#define READY_RETRY_MAX 8000
+
+#define PENDING_TOGGLES_MAX 4
+#define PENDING_COLORS_MAX 4
+
+#define ERROR_LENGTH 96
+
+typedef struct {
+	uint8_t type;
+	uint8_t index;
+} PendingToggle;
+
+typedef struct {
+	uint8_t type;
+	uint8_t index;
+	Color color;
+} PendingColor;
 
-static void timer_callback(void *data);
 static AppTimer *timer;
+static uint32_t ready_delay;
+static uint32_t session;
+static bool ready;
+static bool refresh_pending;
+static PendingToggle pending_toggles[PENDING_TOGGLES_MAX];
+static uint8_t num_pending_toggles;
+static PendingColor pending_colors[PENDING_COLORS_MAX];
+static uint8_t num_pending_colors;
+static bool color_in_flight;
+static char error_text[ERROR_LENGTH];
 
 Light* all_lights;
 Light* lights;
@@ -16,15 +57,15 @@ uint8_t num_lights;
 uint8_t num_tags;
 uint8_t selected_index;
 uint8_t selected_type;
-uint8_t menu_section_lights;
-uint8_t menu_section_tags;
+bool stale;
 
 void light_init(void) {
-	timer = app_timer_register(1000, timer_callback, NULL);
+	session = time(NULL);
+	send_ready(NULL);
 
 	all_lights = malloc(sizeof(Light));
-	all_lights->index = 0;
-	strncpy(all_lights->label, "All Lights", sizeof(all_lights->label) - 1);
+	*all_lights = (Light) { 0 };
+	all_lights->label = fleet_intern(0, "All Lights", strlen("All Lights"));
 	all_lights->color = (Color) {
 		.hue = 50,
 		.saturation = 100,
@@ -37,160 +78,347 @@ void light_init(void) {
 }
 
 void light_deinit(void) {
-	if (error) free(error);
+	app_timer_cancel_safe(timer);
+	operation_deinit();
+	fleet_deinit();
 	if (all_lights) free(all_lights);
-	if (lights) free(lights);
-	if (tags) free(tags);
 	lightlist_deinit();
 }
 
 void light_in_received_handler(DictionaryIterator *iter) {
+	if (dict_find(iter, KEY_METHOD) && dict_find(iter, KEY_METHOD)->value->uint8 == KEY_METHOD_READY) {
+		// The phone's JS just came up, maybe after ours was acked; it needs a READY
+		// to start syncing, so skip any backoff and answer now.
+		app_timer_cancel_safe(timer);
+		ready = false;
+		ready_delay = 0;
+		send_ready(NULL);
+		return;
+	}
 	if (!dict_find(iter, KEY_TYPE)) return;
 	if (error) {
-		free(error);
 		error = NULL;
+		menu_window_invalidate(MENU_DIRTY_ERROR);
 	}
 	switch (dict_find(iter, KEY_TYPE)->value->uint8) {
 		case KEY_TYPE_ERROR: {
-			error = malloc(dict_find(iter, KEY_LABEL)->length);
-			strncpy(error, dict_find(iter, KEY_LABEL)->value->cstring, dict_find(iter, KEY_LABEL)->length - 1);
+			if (dict_find(iter, KEY_OPERATION)) operation_rollback(dict_find(iter, KEY_OPERATION)->value->uint8);
+			set_error(dict_find(iter, KEY_LABEL)->value->cstring);
 			LOG("error: %s", error);
-			all_menu_layer_reload_data_and_mark_dirty();
 			break;
 		}
 		case KEY_TYPE_LIGHT:
-			switch (dict_find(iter, KEY_METHOD)->value->uint8) {
-				case KEY_METHOD_BEGIN:
-					if (lights) free(lights);
-					num_lights = dict_find(iter, KEY_INDEX)->value->uint8;
-					lights = malloc(sizeof(Light) * num_lights);
-					break;
-				case KEY_METHOD_END:
-					all_menu_layer_reload_data_and_mark_dirty();
-					break;
-				case KEY_METHOD_DATA: {
-					uint8_t index = dict_find(iter, KEY_INDEX)->value->uint8;
-					Light *light = &lights[index];
-					light->index = index;
-					strncpy(light->label, dict_find(iter, KEY_LABEL)->value->cstring, sizeof(light->label) - 1);
-					strncpy(light->state, dict_find(iter, KEY_STATE)->value->cstring, sizeof(light->state) - 1);
-					light->color = (Color) {
-						.hue = dict_find(iter, KEY_COLOR_H)->value->uint8,
-						.saturation = dict_find(iter, KEY_COLOR_S)->value->uint8,
-						.brightness = dict_find(iter, KEY_COLOR_B)->value->uint8,
-						.kelvin = dict_find(iter, KEY_COLOR_K)->value->uint16,
-					};
-					LOG("light: %d '%s' '%s' %d %d %d %d", light->index, light->label, light->state, light->color.hue, light->color.saturation, light->color.brightness, light->color.kelvin);
-					all_menu_layer_reload_data_and_mark_dirty();
-					break;
-				}
-			}
+			if (dict_find(iter, KEY_METHOD)->value->uint8 != KEY_METHOD_PATCH) break;
+			patch_records(iter, KEY_TYPE_LIGHT);
 			break;
 		case KEY_TYPE_TAG:
-			switch (dict_find(iter, KEY_METHOD)->value->uint8) {
-				case KEY_METHOD_BEGIN:
-					if (tags) free(tags);
-					num_tags = dict_find(iter, KEY_INDEX)->value->uint8;
-					tags = malloc(sizeof(Light) * num_tags);
-					break;
-				case KEY_METHOD_END:
-					all_menu_layer_reload_data_and_mark_dirty();
-					break;
-				case KEY_METHOD_DATA: {
-					uint8_t index = dict_find(iter, KEY_INDEX)->value->uint8;
-					Light *tag = &tags[index];
-					tag->index = index;
-					strncpy(tag->label, dict_find(iter, KEY_LABEL)->value->cstring, sizeof(tag->label) - 1);
-					strncpy(tag->state, "", sizeof(tag->state) - 1);
-					tag->color = (Color) {
-						.hue = dict_find(iter, KEY_COLOR_H)->value->uint8,
-						.saturation = dict_find(iter, KEY_COLOR_S)->value->uint8,
-						.brightness = dict_find(iter, KEY_COLOR_B)->value->uint8,
-						.kelvin = dict_find(iter, KEY_COLOR_K)->value->uint16,
-					};
-					LOG("tag: %d '%s' '%s' %d %d %d %d", tag->index, tag->label, tag->state, tag->color.hue, tag->color.saturation, tag->color.brightness, tag->color.kelvin);
-					all_menu_layer_reload_data_and_mark_dirty();
-					break;
-				}
-			}
+			if (dict_find(iter, KEY_METHOD)->value->uint8 != KEY_METHOD_PATCH) break;
+			patch_records(iter, KEY_TYPE_TAG);
 			break;
 	}
 }
 
 void light_out_sent_handler(DictionaryIterator *sent) {
+	if (dict_find(sent, KEY_METHOD) && dict_find(sent, KEY_METHOD)->value->uint8 == KEY_METHOD_READY) {
+		ready = true;
+	}
+	if (dict_find(sent, KEY_METHOD) && dict_find(sent, KEY_METHOD)->value->uint8 == KEY_METHOD_COLOR) {
+		color_in_flight = false;
+	}
+	send_pending();
 }
 
 void light_out_failed_handler(DictionaryIterator *failed, AppMessageResult reason) {
-	if (error) free(error);
-	error = malloc(sizeof(char) * 65);
-	strncpy(error, "Unable to connect to phone! Make sure the Pebble app is running.", 64);
-	LOG("error: %s", error);
-	all_menu_layer_reload_data_and_mark_dirty();
+	if (dict_find(failed, KEY_METHOD) && dict_find(failed, KEY_METHOD)->value->uint8 == KEY_METHOD_COLOR) {
+		color_in_flight = false;
+	}
+	send_pending();
+	if (dict_find(failed, KEY_OPERATION)) operation_rollback(dict_find(failed, KEY_OPERATION)->value->uint8);
+	if (!ready && dict_find(failed, KEY_METHOD) && dict_find(failed, KEY_METHOD)->value->uint8 == KEY_METHOD_READY) {
+		retry_ready();
+		if (ready_delay < READY_RETRY_MAX) return;
+	}
+	switch (reason) {
+		case APP_MSG_BUSY:
+			set_error("Phone is busy! Please try again.");
+			break;
+		case APP_MSG_BUFFER_OVERFLOW:
+			set_error("Message was too large for the phone!");
+			break;
+		default:
+			set_error("Unable to connect to phone! Make sure the Pebble app is running.");
+			break;
+	}
+	LOG("error: %d %s", reason, error);
 }
 
 void light_update_settings() {
-	menu_section_lights = settings()->tags_first ? 2 : 1;
-	menu_section_tags = settings()->tags_first ? 1 : 2;
-	menu_section_lights = settings()->hide_lights ? 88 : menu_section_lights;
-	menu_section_tags = settings()->hide_tags ? 89 : menu_section_tags;
-	all_menu_layer_reload_data_and_mark_dirty();
+	lightlist_update_settings();
+	menu_window_invalidate(MENU_DIRTY_SETTINGS);
 }
 
 void light_refresh() {
-	DictionaryIterator *iter;
-	app_message_outbox_begin(&iter);
-	dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_REFRESH);
-	dict_write_end(iter);
-	app_message_outbox_send();
+	refresh_pending = true;
+	send_pending();
 }
 
+// Toggles wait in order for the outbox; a full queue refuses the toggle before touching the row.
 void light_toggle() {
-	if (selected_type == KEY_TYPE_LIGHT)
-		strncpy(light()->state, "...", sizeof(light()->state) - 1);
-	all_menu_layer_reload_data_and_mark_dirty();
-	DictionaryIterator *iter;
-	app_message_outbox_begin(&iter);
-	dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_TOGGLE);
-	dict_write_uint8(iter, KEY_TYPE, selected_type);
-	dict_write_uint8(iter, KEY_INDEX, selected_index);
-	dict_write_end(iter);
-	app_message_outbox_send();
+	if (!light()) return;
+	if (num_pending_toggles == PENDING_TOGGLES_MAX) {
+		vibes_short_pulse();
+		return;
+	}
+	if (selected_type == KEY_TYPE_LIGHT) {
+		operation_begin(selected_type, selected_index);
+		light()->flags ^= LIGHT_FLAG_ON;
+	}
+	menu_window_invalidate(MENU_DIRTY_FLEET);
+	pending_toggles[num_pending_toggles++] = (PendingToggle) {
+		.type = selected_type,
+		.index = selected_index,
+	};
+	send_pending();
 }
 
-void light_update_color() {
-	DictionaryIterator *iter;
-	app_message_outbox_begin(&iter);
-	dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_COLOR);
-	dict_write_uint8(iter, KEY_TYPE, selected_type);
-	dict_write_uint8(iter, KEY_INDEX, selected_index);
-	dict_write_uint8(iter, KEY_COLOR_H, light()->color.hue);
-	dict_write_uint8(iter, KEY_COLOR_S, light()->color.saturation);
-	dict_write_uint8(iter, KEY_COLOR_B, light()->color.brightness);
-	dict_write_uint16(iter, KEY_COLOR_K, light()->color.kelvin);
-	dict_write_end(iter);
-	app_message_outbox_send();
+// Only the newest color per target is kept while an earlier one is still in
+// flight; a new target is refused before touching the row once the table is full.
+void light_set_color(Color color) {
+	if (!light()) return;
+	PendingColor *pending = NULL;
+	for (uint8_t i = 0; i < num_pending_colors; i++) {
+		if (pending_colors[i].type == selected_type && pending_colors[i].index == selected_index) {
+			pending = &pending_colors[i];
+		}
+	}
+	if (!pending) {
+		if (num_pending_colors == PENDING_COLORS_MAX) {
+			vibes_short_pulse();
+			return;
+		}
+		pending = &pending_colors[num_pending_colors++];
+	}
+	operation_begin(selected_type, selected_index);
+	light()->color = color;
+	menu_window_invalidate(MENU_DIRTY_FLEET);
+	*pending = (PendingColor) {
+		.type = selected_type,
+		.index = selected_index,
+		.color = color,
+	};
+	send_pending();
 }
 
-void all_menu_layer_reload_data_and_mark_dirty() {
-	lightlist_reload_data_and_mark_dirty();
+uint16_t light_read_records(const uint8_t *data, uint16_t length, uint8_t count, uint8_t type) {
+	const uint8_t *record = data;
+	const uint8_t *end = data + length;
+	for (uint8_t i = 0; i < count && record + RECORD_LABEL <= end; i++) {
+		uint8_t label_length = record[RECORD_LABEL_LENGTH];
+		if (record + RECORD_LABEL + label_length > end) break;
+		if (light_at(type, record[RECORD_INDEX])) {
+			// Interning can move the tables, so the row is looked up again afterwards.
+			uint16_t label = fleet_intern(light_at(type, record[RECORD_INDEX])->label, (const char*) &record[RECORD_LABEL], label_length);
+			Light *row = light_at(type, record[RECORD_INDEX]);
+			row->index = record[RECORD_INDEX];
+			row->label = label;
+			// A row with a change in flight keeps showing it; the phone's view is held aside.
+			Light *light = operation_intercept(type, record[RECORD_INDEX]);
+			if (!light) light = row;
+			light->flags = type == KEY_TYPE_LIGHT ? LIGHT_FLAG_POWER | (record[RECORD_FLAGS] & RECORD_FLAG_ON ? LIGHT_FLAG_ON : 0) : 0;
+			light->color = (Color) {
+				.hue = record[RECORD_HUE],
+				.saturation = record[RECORD_SATURATION],
+				.brightness = record[RECORD_BRIGHTNESS],
+				.kelvin = record[RECORD_KELVIN] | (record[RECORD_KELVIN + 1] << 8),
+			};
+			LOG("record: %d '%s' '%s' %d %d %d %d", row->index, light_label(row), light_state(light), light->color.hue, light->color.saturation, light->color.brightness, light->color.kelvin);
+		}
+		record += RECORD_LABEL + record[RECORD_LABEL_LENGTH];
+	}
+	return record - data;
+}
+
+// Writes a whole list as the phone last described it.
+uint16_t light_write_records(uint8_t *data, uint8_t type) {
+	uint8_t *record = data;
+	uint8_t num = type == KEY_TYPE_LIGHT ? num_lights : num_tags;
+	for (uint8_t i = 0; i < num; i++) {
+		record += write_record(record, type, i);
+	}
+	return record - data;
+}
+
+// FNV-1a over the phone's view of every light and tag record, the same hash
+// as LIFX.version(), so the phone can tell whether the watch's rows are current.
+uint32_t light_version(void) {
+	uint32_t hash = 2166136261u;
+	uint8_t record[RECORD_LABEL + UINT8_MAX];
+	for (uint8_t type = KEY_TYPE_LIGHT; type <= KEY_TYPE_TAG; type++) {
+		uint8_t num = type == KEY_TYPE_LIGHT ? num_lights : num_tags;
+		for (uint8_t i = 0; i < num; i++) {
+			uint16_t size = write_record(record, type, i);
+			for (uint16_t j = 0; j < size; j++) {
+				hash = (hash ^ record[j]) * 16777619u;
+			}
+		}
+	}
+	return (hash & 0x7fffffff) ? (hash & 0x7fffffff) : 1;
+}
+
+uint16_t light_records_size(const Light *list, uint8_t num) {
+	uint16_t size = 0;
+	for (uint8_t i = 0; i < num; i++) {
+		size += RECORD_LABEL + strlen(light_label(&list[i]));
+	}
+	return size;
 }
 
 Light* light() {
-	switch (selected_type) {
+	return light_at(selected_type, selected_index);
+}
+
+Light* light_at(uint8_t type, uint8_t index) {
+	switch (type) {
 		case KEY_TYPE_ALL:
 			return &all_lights[0];
 		case KEY_TYPE_LIGHT:
-			return &lights[selected_index];
+			return index < num_lights ? &lights[index] : NULL;
 		case KEY_TYPE_TAG:
-			return &tags[selected_index];
+			return index < num_tags ? &tags[index] : NULL;
 	}
 	return NULL;
 }
 
-static void timer_callback(void *data) {
+const char* light_label(const Light *light) {
+	return fleet_label(light->label);
+}
+
+const char* light_state(const Light *light) {
+	if (!(light->flags & LIGHT_FLAG_POWER)) return "";
+	return light->flags & LIGHT_FLAG_ON ? "ON" : "OFF";
+}
+
+static void patch_records(DictionaryIterator *iter, uint8_t type) {
+	if (!fleet_resize(type, dict_find(iter, KEY_INDEX)->value->uint8)) {
+		set_error("Not enough memory for all lights!");
+		return;
+	}
+	// The per-light windows all show the selected row, so they close when it goes away.
+	if (type == selected_type && !light()) lightmenu_deinit();
+	uint8_t count = dict_find(iter, KEY_COUNT)->value->uint8;
+	if (count) {
+		Tuple *data = dict_find(iter, KEY_DATA);
+		light_read_records(data->value->data, data->length, count, type);
+	}
+	if (dict_find(iter, KEY_OPERATION)) {
+		Light *conflict = operation_confirm(dict_find(iter, KEY_OPERATION)->value->uint8);
+		if (conflict) {
+			char text[48];
+			snprintf(text, sizeof(text), "%s was changed elsewhere.", light_label(conflict));
+			set_error(text);
+		}
+	}
+	stale = false;
+	// The version rides on the last message of a patch, so the menus reload once per patch.
+	if (dict_find(iter, KEY_VERSION)) {
+		menu_window_invalidate(MENU_DIRTY_FLEET);
+	} else {
+		menu_window_defer(MENU_DIRTY_FLEET);
+	}
+}
+
+static void send_ready(void *data) {
+	timer = NULL;
 	DictionaryIterator *iter;
-	app_message_outbox_begin(&iter);
+	if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+		retry_ready();
+		return;
+	}
 	dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_READY);
+	dict_write_uint8(iter, KEY_PROTOCOL, PROTOCOL_VERSION);
+	dict_write_uint32(iter, KEY_SESSION, session);
+	dict_write_uint32(iter, KEY_INBOX_SIZE, app_message_inbox_size_maximum());
+	dict_write_uint32(iter, KEY_OUTBOX_SIZE, app_message_outbox_size_maximum());
+	if (num_lights || num_tags) dict_write_uint32(iter, KEY_VERSION, light_version());
+	dict_write_uint8(iter, KEY_PALETTE, palette_count());
+	dict_write_end(iter);
+	app_message_outbox_send();
+}
+
+// Commands wait until the outbox is free and then go one per message: a
+// refresh first, then toggles in order, then colors one at a time.
+static void send_pending(void) {
+	bool color = !color_in_flight && num_pending_colors > 0;
+	if (!refresh_pending && num_pending_toggles == 0 && !color) return;
+	DictionaryIterator *iter;
+	if (app_message_outbox_begin(&iter) != APP_MSG_OK) return;
+	if (refresh_pending) {
+		dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_REFRESH);
+		refresh_pending = false;
+	} else if (num_pending_toggles) {
+		write_toggle(iter);
+	} else {
+		write_color(iter);
+	}
 	dict_write_end(iter);
 	app_message_outbox_send();
 }
+
+static void write_toggle(DictionaryIterator *iter) {
+	PendingToggle pending = pending_toggles[0];
+	num_pending_toggles--;
+	memmove(&pending_toggles[0], &pending_toggles[1], sizeof(PendingToggle) * num_pending_toggles);
+	dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_TOGGLE);
+	dict_write_uint8(iter, KEY_TYPE, pending.type);
+	dict_write_uint8(iter, KEY_INDEX, pending.index);
+	uint8_t operation = operation_sent(pending.type, pending.index);
+	if (operation) dict_write_uint8(iter, KEY_OPERATION, operation);
+}
+
+static void write_color(DictionaryIterator *iter) {
+	PendingColor pending = pending_colors[0];
+	num_pending_colors--;
+	memmove(&pending_colors[0], &pending_colors[1], sizeof(PendingColor) * num_pending_colors);
+	dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_COLOR);
+	dict_write_uint8(iter, KEY_TYPE, pending.type);
+	dict_write_uint8(iter, KEY_INDEX, pending.index);
+	dict_write_uint8(iter, KEY_COLOR_H, pending.color.hue);
+	dict_write_uint8(iter, KEY_COLOR_S, pending.color.saturation);
+	dict_write_uint8(iter, KEY_COLOR_B, pending.color.brightness);
+	dict_write_uint16(iter, KEY_COLOR_K, pending.color.kelvin);
+	uint8_t operation = operation_sent(pending.type, pending.index);
+	if (operation) dict_write_uint8(iter, KEY_OPERATION, operation);
+	color_in_flight = true;
+}
+
+// A row with an operation pending shows the expected state; the phone's view is held aside.
+static uint16_t write_record(uint8_t *record, uint8_t type, uint8_t index) {
+	const Light *light = light_at(type, index);
+	const Light *view = operation_previous(type, index);
+	if (!view) view = light;
+	uint8_t label_length = strlen(light_label(light));
+	record[RECORD_INDEX] = light->index;
+	record[RECORD_FLAGS] = view->flags & LIGHT_FLAG_ON ? RECORD_FLAG_ON : 0;
+	record[RECORD_HUE] = view->color.hue;
+	record[RECORD_SATURATION] = view->color.saturation;
+	record[RECORD_BRIGHTNESS] = view->color.brightness;
+	record[RECORD_KELVIN] = view->color.kelvin & 0xff;
+	record[RECORD_KELVIN + 1] = view->color.kelvin >> 8;
+	record[RECORD_LABEL_LENGTH] = label_length;
+	memcpy(&record[RECORD_LABEL], light_label(light), label_length);
+	return RECORD_LABEL + label_length;
+}
+
+static void set_error(const char *text) {
+	strncpy(error_text, text, sizeof(error_text) - 1);
+	error = error_text;
+	menu_window_invalidate(MENU_DIRTY_ERROR);
+}
+
+static void retry_ready(void) {
+	ready_delay = ready_delay ? ready_delay * 2 : READY_RETRY_MIN;
+	if (ready_delay > READY_RETRY_MAX) ready_delay = READY_RETRY_MAX;
+	LOG("ready: retrying in %d ms", (int) ready_delay);
+	app_timer_cancel_safe(timer);
+	timer = app_timer_register(ready_delay, send_ready, NULL);
+}
@@ -7,10 +7,14 @@ typedef struct {
 	uint16_t kelvin;
 } Color;
 
+#define LIGHT_FLAG_ON 0x01
+#define LIGHT_FLAG_POWER 0x02
+
+// Labels live in the fleet arena; see fleet.c.
 typedef struct {
+	uint16_t label;
 	uint8_t index;
-	char label[18];
-	char state[5];
+	uint8_t flags;
 	Color color;
 } Light;
 
@@ -22,8 +26,7 @@ extern uint8_t num_lights;
 extern uint8_t num_tags;
 extern uint8_t selected_index;
 extern uint8_t selected_type;
-extern uint8_t menu_section_lights;
-extern uint8_t menu_section_tags;
+extern bool stale;
 
 void light_init(void);
 void light_deinit(void);
@@ -35,6 +38,12 @@ void light_refresh();
 void light_toggle();
 void light_on();
 void light_off();
-void light_update_color();
-void all_menu_layer_reload_data_and_mark_dirty();
+void light_set_color(Color color);
+uint16_t light_read_records(const uint8_t *data, uint16_t length, uint8_t count, uint8_t type);
+uint16_t light_write_records(uint8_t *data, uint8_t type);
+uint32_t light_version(void);
+uint16_t light_records_size(const Light *list, uint8_t num);
 Light* light();
+const char* light_label(const Light *light);
+const char* light_state(const Light *light);
+Light* light_at(uint8_t type, uint8_t index);
@@ -1,16 +1,25 @@
 #include <pebble.h>
 #include "appmessage.h"
 #include "settings.h"
+#include "cache.h"
+#include "scene.h"
+#include "palette.h"
 #include "light.h"
 
 static void init(void) {
 	appmessage_init();
 	settings_load();
+	scene_load();
+	palette_load();
+	cache_load();
 	light_init();
 }
 
 static void deinit(void) {
 	settings_save();
+	scene_save();
+	palette_save();
+	cache_save();
 	light_deinit();
 }
 
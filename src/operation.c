@@ -0,0 +1,148 @@
+#include <pebble.h>
+#include "libs/pebble-assist.h"
+#include "common.h"
+#include "light.h"
+#include "operation.h"
+#include "windows/menu_window.h"
+
+// Optimistic changes waiting for the phone. Each operation remembers the
+// target as the phone last described it: first the state from before the
+// change, then whatever records arrive while the operation is pending. The
+// row itself keeps showing the expected state until the phone confirms or
+// the message fails. An operation the phone never answers is rolled back to
+// that last record after OPERATION_TIMEOUT seconds.
+
+#define OPERATIONS_MAX 8
+#define OPERATION_TIMEOUT 15
+#define OPERATION_CHECK_INTERVAL 1000
+
+typedef struct {
+	uint8_t id;
+	uint8_t type;
+	uint8_t index;
+	bool received;
+	time_t started;
+	// Only flags and color are kept current; the label offset goes stale when the fleet is rebuilt.
+	Light previous;
+} Operation;
+
+static Operation* find(uint8_t type, uint8_t index);
+static Operation* find_id(uint8_t id);
+static void restore(Operation *operation);
+static void finish(Operation *operation);
+static void expire(void *data);
+
+static Operation operations[OPERATIONS_MAX];
+static uint8_t num_operations;
+static uint8_t next_id;
+static AppTimer *timer;
+
+void operation_begin(uint8_t type, uint8_t index) {
+	Light *light = light_at(type, index);
+	if (!light || find(type, index) || num_operations == OPERATIONS_MAX) return;
+	operations[num_operations++] = (Operation) {
+		.type = type,
+		.index = index,
+		.started = time(NULL),
+		.previous = *light,
+	};
+	if (!timer) timer = app_timer_register(OPERATION_CHECK_INTERVAL, expire, NULL);
+}
+
+uint8_t operation_sent(uint8_t type, uint8_t index) {
+	Operation *operation = find(type, index);
+	if (!operation) return 0;
+	if (++next_id == 0) next_id = 1;
+	return operation->id = next_id;
+}
+
+Light* operation_intercept(uint8_t type, uint8_t index) {
+	Operation *operation = find(type, index);
+	if (!operation) return NULL;
+	operation->received = true;
+	return &operation->previous;
+}
+
+// The target as the phone last described it, or NULL without a pending operation.
+const Light* operation_previous(uint8_t type, uint8_t index) {
+	Operation *operation = find(type, index);
+	return operation ? &operation->previous : NULL;
+}
+
+Light* operation_confirm(uint8_t id) {
+	Operation *operation = find_id(id);
+	if (!operation) return NULL;
+	Light *light = light_at(operation->type, operation->index);
+	bool conflict = false;
+	if (light && operation->received) {
+		conflict = ((light->flags ^ operation->previous.flags) & LIGHT_FLAG_ON)
+			|| abs(light->color.hue - operation->previous.color.hue) > 1
+			|| abs(light->color.saturation - operation->previous.color.saturation) > 1
+			|| abs(light->color.brightness - operation->previous.color.brightness) > 1
+			|| abs(light->color.kelvin - operation->previous.color.kelvin) > 1;
+		light->flags = operation->previous.flags;
+		light->color = operation->previous.color;
+	}
+	finish(operation);
+	return conflict ? light : NULL;
+}
+
+void operation_rollback(uint8_t id) {
+	Operation *operation = find_id(id);
+	if (!operation) return;
+	LOG("operation_rollback: %d", id);
+	restore(operation);
+	finish(operation);
+}
+
+void operation_deinit(void) {
+	app_timer_cancel_safe(timer);
+	num_operations = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static Operation* find(uint8_t type, uint8_t index) {
+	for (uint8_t i = 0; i < num_operations; i++) {
+		if (operations[i].type == type && operations[i].index == index) return &operations[i];
+	}
+	return NULL;
+}
+
+static Operation* find_id(uint8_t id) {
+	if (id == 0) return NULL;
+	for (uint8_t i = 0; i < num_operations; i++) {
+		if (operations[i].id == id) return &operations[i];
+	}
+	return NULL;
+}
+
+static void restore(Operation *operation) {
+	Light *light = light_at(operation->type, operation->index);
+	if (!light) return;
+	light->flags = operation->previous.flags;
+	light->color = operation->previous.color;
+}
+
+static void finish(Operation *operation) {
+	num_operations--;
+	memmove(operation, operation + 1, sizeof(Operation) * (&operations[num_operations] - operation));
+}
+
+static void expire(void *data) {
+	timer = NULL;
+	time_t now = time(NULL);
+	bool expired = false;
+	for (uint8_t i = 0; i < num_operations; ) {
+		if (now - operations[i].started < OPERATION_TIMEOUT) {
+			i++;
+			continue;
+		}
+		LOG("operation_expire: %d", operations[i].id);
+		restore(&operations[i]);
+		finish(&operations[i]);
+		expired = true;
+	}
+	if (expired) menu_window_invalidate(MENU_DIRTY_FLEET);
+	if (num_operations) timer = app_timer_register(OPERATION_CHECK_INTERVAL, expire, NULL);
+}
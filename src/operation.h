@@ -0,0 +1,9 @@
+#pragma once
+
+void operation_begin(uint8_t type, uint8_t index);
+uint8_t operation_sent(uint8_t type, uint8_t index);
+Light* operation_intercept(uint8_t type, uint8_t index);
+const Light* operation_previous(uint8_t type, uint8_t index);
+Light* operation_confirm(uint8_t id);
+void operation_rollback(uint8_t id);
+void operation_deinit(void);
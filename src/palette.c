@@ -0,0 +1,87 @@
+#include <pebble.h>
+#include "palette.h"
+#include "common.h"
+#include "libs/pebble-assist.h"
+#include "windows/menu_window.h"
+
+static bool insert(Color color);
+static void send(bool added, Color color);
+
+// Custom colors live on the watch; the phone only mirrors each change so it
+// can hand them back to a watch that starts out empty.
+typedef struct {
+	uint8_t count;
+	Color colors[PALETTE_MAX];
+} Palette;
+
+static Palette palette;
+
+void palette_load(void) {
+	int res = persist_exists(KEY_PALETTE_COLORS) ? persist_read_data(KEY_PALETTE_COLORS, &palette, sizeof(palette)) : 0;
+	if (res <= 0 || palette.count > PALETTE_MAX) palette.count = 0;
+	LOG("palette_load: %d", palette.count);
+}
+
+void palette_save(void) {
+	int res = persist_write_data(KEY_PALETTE_COLORS, &palette, sizeof(palette));
+	LOG("palette_save: %d", res);
+}
+
+uint8_t palette_count(void) {
+	return palette.count;
+}
+
+Color palette_color(uint8_t index) {
+	return palette.colors[index];
+}
+
+void palette_add(Color color) {
+	if (insert(color)) send(true, color);
+}
+
+void palette_remove(uint8_t index) {
+	Color color = palette.colors[index];
+	palette.count--;
+	memmove(&palette.colors[index], &palette.colors[index + 1], sizeof(Color) * (palette.count - index));
+	menu_window_invalidate(MENU_DIRTY_PALETTE);
+	send(false, color);
+}
+
+// Colors handed back by the phone are not echoed to it.
+void palette_in_received_handler(DictionaryIterator *iter) {
+	if (!dict_find(iter, KEY_STATE) || !dict_find(iter, KEY_STATE)->value->uint8) return;
+	insert((Color) {
+		.hue = dict_find(iter, KEY_COLOR_H)->value->uint8,
+		.saturation = dict_find(iter, KEY_COLOR_S)->value->uint8,
+		.brightness = dict_find(iter, KEY_COLOR_B)->value->uint8,
+		.kelvin = dict_find(iter, KEY_COLOR_K)->value->uint16,
+	});
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+// Newest first; a color already saved stays where it is and a full palette drops its oldest.
+static bool insert(Color color) {
+	for (uint8_t i = 0; i < palette.count; i++) {
+		Color *saved = &palette.colors[i];
+		if (saved->hue == color.hue && saved->saturation == color.saturation && saved->brightness == color.brightness && saved->kelvin == color.kelvin) return false;
+	}
+	if (palette.count < PALETTE_MAX) palette.count++;
+	memmove(&palette.colors[1], &palette.colors[0], sizeof(Color) * (palette.count - 1));
+	palette.colors[0] = color;
+	menu_window_invalidate(MENU_DIRTY_PALETTE);
+	return true;
+}
+
+static void send(bool added, Color color) {
+	DictionaryIterator *iter;
+	if (app_message_outbox_begin(&iter) != APP_MSG_OK) return;
+	dict_write_uint8(iter, KEY_METHOD, KEY_METHOD_PALETTE);
+	dict_write_uint8(iter, KEY_STATE, added);
+	dict_write_uint8(iter, KEY_COLOR_H, color.hue);
+	dict_write_uint8(iter, KEY_COLOR_S, color.saturation);
+	dict_write_uint8(iter, KEY_COLOR_B, color.brightness);
+	dict_write_uint16(iter, KEY_COLOR_K, color.kelvin);
+	dict_write_end(iter);
+	app_message_outbox_send();
+}
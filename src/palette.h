@@ -0,0 +1,13 @@
+#pragma once
+
+#include "light.h"
+
+#define PALETTE_MAX 12
+
+void palette_load(void);
+void palette_save(void);
+uint8_t palette_count(void);
+Color palette_color(uint8_t index);
+void palette_add(Color color);
+void palette_remove(uint8_t index);
+void palette_in_received_handler(DictionaryIterator *iter);
@@ -0,0 +1,76 @@
+#include <pebble.h>
+#include "scene.h"
+#include "common.h"
+#include "light.h"
+#include "libs/pebble-assist.h"
+
+static bool send(uint8_t method, uint8_t slot);
+static void name(Scene *scene);
+
+static Scene scenes[SCENES_MAX];
+static uint8_t num_scenes;
+
+void scene_load(void) {
+	int res = persist_exists(KEY_SCENES) ? persist_read_data(KEY_SCENES, scenes, sizeof(scenes)) : 0;
+	num_scenes = 0;
+	while (res > 0 && num_scenes < SCENES_MAX && scenes[num_scenes].label[0]) num_scenes++;
+	LOG("scene_load: %d", num_scenes);
+}
+
+void scene_save(void) {
+	if (num_scenes < SCENES_MAX) scenes[num_scenes].label[0] = '\0';
+	int res = persist_write_data(KEY_SCENES, scenes, sizeof(Scene) * (num_scenes < SCENES_MAX ? num_scenes + 1 : SCENES_MAX));
+	LOG("scene_save: %d", res);
+}
+
+uint8_t scene_count(void) {
+	return num_scenes;
+}
+
+const char* scene_label(uint8_t index) {
+	return scenes[index].label;
+}
+
+// Takes the lowest free slot; returns false when every slot is used or the
+// phone can't be told, so the list never shows a scene the phone doesn't have.
+bool scene_capture(void) {
+	if (num_scenes >= SCENES_MAX) return false;
+	uint8_t used = 0;
+	for (uint8_t i = 0; i < num_scenes; i++) used |= 1 << scenes[i].slot;
+	uint8_t slot = 0;
+	while (used & (1 << slot)) slot++;
+	if (!send(KEY_METHOD_SCENE_SAVE, slot)) return false;
+	Scene *scene = &scenes[num_scenes++];
+	scene->slot = slot;
+	name(scene);
+	return true;
+}
+
+bool scene_replace(uint8_t index) {
+	if (!send(KEY_METHOD_SCENE_SAVE, scenes[index].slot)) return false;
+	name(&scenes[index]);
+	return true;
+}
+
+bool scene_restore(uint8_t index) {
+	return send(KEY_METHOD_SCENE_RESTORE, scenes[index].slot);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static bool send(uint8_t method, uint8_t slot) {
+	DictionaryIterator *iter;
+	if (app_message_outbox_begin(&iter) != APP_MSG_OK) return false;
+	dict_write_uint8(iter, KEY_METHOD, method);
+	if (method == KEY_METHOD_SCENE_SAVE) {
+		dict_write_uint8(iter, KEY_TYPE, selected_type);
+		dict_write_uint8(iter, KEY_INDEX, selected_index);
+	}
+	dict_write_uint8(iter, KEY_SCENE, slot);
+	dict_write_end(iter);
+	return app_message_outbox_send() == APP_MSG_OK;
+}
+
+static void name(Scene *scene) {
+	snprintf(scene->label, SCENE_LABEL_LENGTH, "%d %s", scene->slot + 1, light_label(light()));
+}
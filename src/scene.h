@@ -0,0 +1,18 @@
+#pragma once
+
+#define SCENES_MAX 8
+#define SCENE_LABEL_LENGTH 15
+
+// The phone keeps each scene's per-light snapshot under its slot; the watch only keeps the list.
+typedef struct {
+	uint8_t slot;
+	char label[SCENE_LABEL_LENGTH];
+} Scene;
+
+void scene_load(void);
+void scene_save(void);
+uint8_t scene_count(void);
+const char* scene_label(uint8_t index);
+bool scene_capture(void);
+bool scene_replace(uint8_t index);
+bool scene_restore(uint8_t index);
@@ -3,110 +3,67 @@
 #include "../libs/pebble-assist.h"
 #include "../common.h"
 #include "../light.h"
+#include "../palette.h"
+#include "menu_window.h"
 
-#define MENU_NUM_SECTIONS 2
+static void prepare(uint8_t dirty);
+static uint16_t custom_count(void);
+static const char* custom_label(uint16_t row);
+static void custom_select(uint16_t row);
+static void custom_select_long(uint16_t row);
 
-#define MENU_SECTION_STATUS 0
-#define MENU_SECTION_CUSTOM 1
+static char labels[PALETTE_MAX][16];
 
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+// Select applies a saved color; a long press removes it.
+static const MenuSection sections[] = {
+	{ .header = MENU_HEADER_STATUS },
+	{ .header = MENU_HEADER_BASIC, .title = "Custom colors", .count = custom_count, .label = custom_label, .select = custom_select, .select_long = custom_select_long },
+};
 
-static Window *window;
-static MenuLayer *menu_layer;
+static const MenuDescriptor descriptor = {
+	.sections = sections,
+	.num_sections = ARRAY_LENGTH(sections),
+	.cell_height = 36,
+	.depends = MENU_DIRTY_FLEET | MENU_DIRTY_PALETTE,
+	.prepare = prepare,
+};
 
-static uint8_t num_custom_colors = 0;
-
-void colors_custom_init(void) {
-	window = window_create();
-
-	menu_layer = menu_layer_create_fullscreen(window);
-	menu_layer_set_callbacks(menu_layer, NULL, (MenuLayerCallbacks) {
-		.get_num_sections = menu_get_num_sections_callback,
-		.get_num_rows = menu_get_num_rows_callback,
-		.get_header_height = menu_get_header_height_callback,
-		.get_cell_height = menu_get_cell_height_callback,
-		.draw_header = menu_draw_header_callback,
-		.draw_row = menu_draw_row_callback,
-		.select_click = menu_select_callback,
-	});
-	menu_layer_set_click_config_onto_window(menu_layer, window);
-	menu_layer_add_to_window(menu_layer, window);
-}
+static MenuWindow menu;
 
 void colors_custom_show(void) {
-	window_stack_push(window, true);
+	menu_window_show(&menu, &descriptor);
 }
 
 void colors_custom_deinit(void) {
-	menu_layer_destroy_safe(menu_layer);
-	window_destroy_safe(window);
+	menu_window_deinit(&menu);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
 
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
-	return MENU_NUM_SECTIONS;
-}
-
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	switch (section_index) {
-		case MENU_SECTION_STATUS:
-			return 0;
-		case MENU_SECTION_CUSTOM:
-			return num_custom_colors ? num_custom_colors : 1;
+static void prepare(uint8_t dirty) {
+	if (!(dirty & MENU_DIRTY_PALETTE)) return;
+	for (uint8_t i = 0; i < palette_count(); i++) {
+		Color color = palette_color(i);
+		if (color.saturation == 0) {
+			snprintf(labels[i], sizeof(labels[i]), "%dK %d%%", color.kelvin, color.brightness);
+		} else {
+			snprintf(labels[i], sizeof(labels[i]), "H%d S%d B%d", color.hue, color.saturation, color.brightness);
+		}
 	}
-	return 0;
 }
 
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	switch (section_index) {
-		case MENU_SECTION_STATUS:
-			return 28;
-		case MENU_SECTION_CUSTOM:
-			return MENU_CELL_BASIC_HEADER_HEIGHT;
-	}
-	return 0;
+static uint16_t custom_count(void) {
+	return palette_count() ? palette_count() : 1;
 }
 
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	return 36;
+static const char* custom_label(uint16_t row) {
+	return palette_count() ? labels[row] : "None added";
 }
 
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
-	graphics_context_set_text_color(ctx, GColorBlack);
-	switch (section_index) {
-		case MENU_SECTION_STATUS:
-			graphics_draw_text(ctx, light()->label, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { 100, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-			graphics_draw_text(ctx, light()->state, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), (GRect) { .origin = { 110, -3 }, .size = { 30, 26 } }, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
-			break;
-		case MENU_SECTION_CUSTOM:
-			menu_cell_basic_header_draw(ctx, cell_layer, "Custom colors");
-			break;
-	}
+static void custom_select(uint16_t row) {
+	if (palette_count()) light_set_color(palette_color(row));
 }
 
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
-	graphics_context_set_text_color(ctx, GColorBlack);
-	switch (cell_index->section) {
-		case MENU_SECTION_CUSTOM:
-			if (num_custom_colors == 0) {
-				graphics_draw_text(ctx, "Loading...", fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 4 }, .size = { PEBBLE_WIDTH - 8, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-			} else {
-				graphics_draw_text(ctx, "None added", fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), (GRect) { .origin = { 4, 0 }, .size = { PEBBLE_WIDTH - 8, 28 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-			}
-			break;
-	}
-}
-
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	switch (cell_index->section) {
-		case MENU_SECTION_CUSTOM:
-			break;
-	}
+static void custom_select_long(uint16_t row) {
+	if (palette_count()) palette_remove(row);
 }
@@ -1,9 +1,4 @@
 #pragma once
 
-void colors_custom_init(void);
 void colors_custom_show(void);
 void colors_custom_deinit(void);
-void colors_custom_in_received_handler(DictionaryIterator *iter);
-void colors_custom_out_sent_handler(DictionaryIterator *sent);
-void colors_custom_out_failed_handler(DictionaryIterator *failed, AppMessageResult reason);
-bool colors_custom_is_on_top();
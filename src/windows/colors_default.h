@@ -1,6 +1,4 @@
 #pragma once
 
-void colors_default_init(void);
 void colors_default_show(void);
 void colors_default_deinit(void);
-void colors_default_reload_data_and_mark_dirty(void);
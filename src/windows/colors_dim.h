@@ -1,6 +1,4 @@
 #pragma once
 
-void colors_dim_init(void);
 void colors_dim_show(void);
 void colors_dim_deinit(void);
-void colors_dim_reload_data_and_mark_dirty(void);
@@ -3,26 +3,12 @@
 #include "../libs/pebble-assist.h"
 #include "../common.h"
 #include "../light.h"
+#include "../palette.h"
+#include "menu_window.h"
 
-#define MENU_NUM_SECTIONS 2
-
-#define MENU_SECTION_STATUS 0
-#define MENU_SECTION_MANUAL 1
-
-#define MENU_SECTION_ROWS_MANUAL 4
-
-#define MENU_ROW_MANUAL_HUE 0
-#define MENU_ROW_MANUAL_SATURATION 1
-#define MENU_ROW_MANUAL_BRIGHTNESS 2
-#define MENU_ROW_MANUAL_KELVIN 3
-
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void number_window_show(int16_t field);
+static void number_windows_destroy(void);
+static void save(int16_t value);
 static void hue_update(uint8_t value);
 static void hue_decrement_callback(struct NumberWindow *number_window, void *context);
 static void hue_increment_callback(struct NumberWindow *number_window, void *context);
@@ -30,9 +16,8 @@ static void hue_select_callback(struct NumberWindow *number_window, void *contex
 static void saturation_select_callback(struct NumberWindow *number_window, void *context);
 static void brightness_select_callback(struct NumberWindow *number_window, void *context);
 static void kelvin_select_callback(struct NumberWindow *number_window, void *context);
+static NumberWindow* number_window_get(uint8_t field);
 
-static Window *window;
-static MenuLayer *menu_layer;
 static NumberWindow *number_window[4];
 
 enum {
@@ -42,154 +27,82 @@ enum {
 	KELVIN,
 };
 
-void colors_manual_init(void) {
-	window = window_create();
-
-	menu_layer = menu_layer_create_fullscreen(window);
-	menu_layer_set_callbacks(menu_layer, NULL, (MenuLayerCallbacks) {
-		.get_num_sections = menu_get_num_sections_callback,
-		.get_num_rows = menu_get_num_rows_callback,
-		.get_header_height = menu_get_header_height_callback,
-		.get_cell_height = menu_get_cell_height_callback,
-		.draw_header = menu_draw_header_callback,
-		.draw_row = menu_draw_row_callback,
-		.select_click = menu_select_callback,
-	});
-	menu_layer_set_click_config_onto_window(menu_layer, window);
-	menu_layer_add_to_window(menu_layer, window);
-
-	number_window[HUE] = number_window_create("Hue", (NumberWindowCallbacks) { .selected = hue_select_callback, .incremented = hue_increment_callback, .decremented = hue_decrement_callback }, NULL);
-	number_window_set_min(number_window[HUE], 0);
-	number_window_set_max(number_window[HUE], 100);
-	number_window_set_step_size(number_window[HUE], 5);
-
-	number_window[SATURATION] = number_window_create("Saturation", (NumberWindowCallbacks) { .selected = saturation_select_callback }, NULL);
-	number_window_set_min(number_window[SATURATION], 0);
-	number_window_set_max(number_window[SATURATION], 100);
-	number_window_set_step_size(number_window[SATURATION], 1);
-
-	number_window[BRIGHTNESS] = number_window_create("Brightness", (NumberWindowCallbacks) { .selected = brightness_select_callback }, NULL);
-	number_window_set_min(number_window[BRIGHTNESS], 0);
-	number_window_set_max(number_window[BRIGHTNESS], 100);
-	number_window_set_step_size(number_window[BRIGHTNESS], 1);
-
-	number_window[KELVIN] = number_window_create("Kelvin", (NumberWindowCallbacks) { .selected = kelvin_select_callback }, NULL);
-	number_window_set_min(number_window[KELVIN], 2500);
-	number_window_set_max(number_window[KELVIN], 10000);
-	number_window_set_step_size(number_window[KELVIN], 500);
-}
-
-void colors_manual_show(void) {
-	window_stack_push(window, true);
-}
+static const MenuRow fields[] = {
+	{ "Hue", number_window_show, HUE },
+	{ "Saturation", number_window_show, SATURATION },
+	{ "Brightness", number_window_show, BRIGHTNESS },
+	{ "Kelvin", number_window_show, KELVIN },
+};
 
-void colors_manual_deinit(void) {
-	for (int i = 0; i < 4; i++) {
-		number_window_destroy(number_window[i]);
-	}
-	menu_layer_destroy_safe(menu_layer);
-	window_destroy_safe(window);
-}
+static const MenuRow save_rows[] = {
+	{ "Save as custom", save, 0 },
+};
 
-void colors_manual_reload_data_and_mark_dirty(void) {
-	menu_layer_reload_data_and_mark_dirty(menu_layer);
-}
+static const MenuSection sections[] = {
+	{ .header = MENU_HEADER_STATUS },
+	{ .header = MENU_HEADER_BASIC, .title = "Manual colors", .rows = fields, .num_rows = ARRAY_LENGTH(fields) },
+	{ .header = MENU_HEADER_NONE, .rows = save_rows, .num_rows = ARRAY_LENGTH(save_rows) },
+};
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+static const MenuDescriptor descriptor = {
+	.sections = sections,
+	.num_sections = ARRAY_LENGTH(sections),
+	.cell_height = 36,
+	.depends = MENU_DIRTY_FLEET,
+	.unload = number_windows_destroy,
+};
 
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
-	return MENU_NUM_SECTIONS;
-}
+static MenuWindow menu;
 
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	switch (section_index) {
-		case MENU_SECTION_STATUS:
-			return 0;
-		case MENU_SECTION_MANUAL:
-			return MENU_SECTION_ROWS_MANUAL;
-	}
-	return 0;
+void colors_manual_show(void) {
+	menu_window_show(&menu, &descriptor);
 }
 
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	switch (section_index) {
-		case MENU_SECTION_STATUS:
-			return 28;
-		case MENU_SECTION_MANUAL:
-			return MENU_CELL_BASIC_HEADER_HEIGHT;
+void colors_manual_deinit(void) {
+	for (int i = 0; i < 4; i++) {
+		if (number_window[i]) window_stack_remove((Window*)number_window[i], false);
 	}
-	return 0;
+	menu_window_deinit(&menu);
 }
 
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	return 36;
-}
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
 
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
-	graphics_context_set_text_color(ctx, GColorBlack);
-	switch (section_index) {
-		case MENU_SECTION_STATUS:
-			graphics_draw_text(ctx, light()->label, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { 100, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-			graphics_draw_text(ctx, light()->state, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), (GRect) { .origin = { 110, -3 }, .size = { 30, 26 } }, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
+static void number_window_show(int16_t field) {
+	uint16_t value = 0;
+	switch (field) {
+		case HUE:
+			value = light()->color.hue;
+			break;
+		case SATURATION:
+			value = light()->color.saturation;
+			break;
+		case BRIGHTNESS:
+			value = light()->color.brightness;
 			break;
-		case MENU_SECTION_MANUAL:
-			menu_cell_basic_header_draw(ctx, cell_layer, "Manual colors");
+		case KELVIN:
+			value = light()->color.kelvin;
 			break;
 	}
+	number_window_set_value(number_window_get(field), value);
+	window_stack_push((Window*)number_window[field], true);
 }
 
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
-	char label[12] = "";
-	switch (cell_index->section) {
-		case MENU_SECTION_MANUAL:
-			switch (cell_index->row) {
-				case MENU_ROW_MANUAL_HUE:
-					strcpy(label, "Hue");
-					break;
-				case MENU_ROW_MANUAL_SATURATION:
-					strcpy(label, "Saturation");
-					break;
-				case MENU_ROW_MANUAL_BRIGHTNESS:
-					strcpy(label, "Brightness");
-					break;
-				case MENU_ROW_MANUAL_KELVIN:
-					strcpy(label, "Kelvin");
-					break;
-			}
-			break;
-	}
-	graphics_context_set_text_color(ctx, GColorBlack);
-	graphics_draw_text(ctx, label, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), (GRect) { .origin = { 4, 0 }, .size = { PEBBLE_WIDTH - 8, 28 } }, GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+static void save(int16_t value) {
+	palette_add(light()->color);
+	vibes_short_pulse();
 }
 
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	switch (cell_index->section) {
-		case MENU_SECTION_MANUAL:
-			switch (cell_index->row) {
-				case MENU_ROW_MANUAL_HUE:
-					number_window_set_value(number_window[HUE], light()->color.hue);
-					window_stack_push((Window*)number_window[HUE], true);
-					break;
-				case MENU_ROW_MANUAL_SATURATION:
-					number_window_set_value(number_window[SATURATION], light()->color.saturation);
-					window_stack_push((Window*)number_window[SATURATION], true);
-					break;
-				case MENU_ROW_MANUAL_BRIGHTNESS:
-					number_window_set_value(number_window[BRIGHTNESS], light()->color.brightness);
-					window_stack_push((Window*)number_window[BRIGHTNESS], true);
-					break;
-				case MENU_ROW_MANUAL_KELVIN:
-					number_window_set_value(number_window[KELVIN], light()->color.kelvin);
-					window_stack_push((Window*)number_window[KELVIN], true);
-					break;
-			}
-			break;
+static void number_windows_destroy(void) {
+	for (int i = 0; i < 4; i++) {
+		if (number_window[i]) number_window_destroy(number_window[i]);
+		number_window[i] = NULL;
 	}
 }
 
 static void hue_update(uint8_t value) {
-	light()->color.hue = value;
-	light_update_color();
+	Color color = light()->color;
+	color.hue = value;
+	light_set_color(color);
 }
 
 static void hue_decrement_callback(struct NumberWindow *number_window, void *context) {
@@ -206,19 +119,54 @@ static void hue_select_callback(struct NumberWindow *number_window, void *contex
 }
 
 static void saturation_select_callback(struct NumberWindow *number_window, void *context) {
-	light()->color.saturation = number_window_get_value(number_window);
-	light_update_color();
+	Color color = light()->color;
+	color.saturation = number_window_get_value(number_window);
+	light_set_color(color);
 	window_stack_pop(true);
 }
 
 static void brightness_select_callback(struct NumberWindow *number_window, void *context) {
-	light()->color.brightness = number_window_get_value(number_window);
-	light_update_color();
+	Color color = light()->color;
+	color.brightness = number_window_get_value(number_window);
+	light_set_color(color);
 	window_stack_pop(true);
 }
 
 static void kelvin_select_callback(struct NumberWindow *number_window, void *context) {
-	light()->color.kelvin = number_window_get_value(number_window);
-	light_update_color();
+	Color color = light()->color;
+	color.kelvin = number_window_get_value(number_window);
+	light_set_color(color);
 	window_stack_pop(true);
 }
+
+// Number windows are made on first use and released with the manual window.
+static NumberWindow* number_window_get(uint8_t field) {
+	if (number_window[field]) return number_window[field];
+	switch (field) {
+		case HUE:
+			number_window[HUE] = number_window_create("Hue", (NumberWindowCallbacks) { .selected = hue_select_callback, .incremented = hue_increment_callback, .decremented = hue_decrement_callback }, NULL);
+			number_window_set_min(number_window[HUE], 0);
+			number_window_set_max(number_window[HUE], 100);
+			number_window_set_step_size(number_window[HUE], 5);
+			break;
+		case SATURATION:
+			number_window[SATURATION] = number_window_create("Saturation", (NumberWindowCallbacks) { .selected = saturation_select_callback }, NULL);
+			number_window_set_min(number_window[SATURATION], 0);
+			number_window_set_max(number_window[SATURATION], 100);
+			number_window_set_step_size(number_window[SATURATION], 1);
+			break;
+		case BRIGHTNESS:
+			number_window[BRIGHTNESS] = number_window_create("Brightness", (NumberWindowCallbacks) { .selected = brightness_select_callback }, NULL);
+			number_window_set_min(number_window[BRIGHTNESS], 0);
+			number_window_set_max(number_window[BRIGHTNESS], 100);
+			number_window_set_step_size(number_window[BRIGHTNESS], 1);
+			break;
+		case KELVIN:
+			number_window[KELVIN] = number_window_create("Kelvin", (NumberWindowCallbacks) { .selected = kelvin_select_callback }, NULL);
+			number_window_set_min(number_window[KELVIN], 2500);
+			number_window_set_max(number_window[KELVIN], 10000);
+			number_window_set_step_size(number_window[KELVIN], 500);
+			break;
+	}
+	return number_window[field];
+}
@@ -1,6 +1,4 @@
 #pragma once
 
-void colors_manual_init(void);
 void colors_manual_show(void);
 void colors_manual_deinit(void);
-void colors_manual_reload_data_and_mark_dirty(void);
@@ -6,180 +6,175 @@
 #include "../settings.h"
 #include "settings.h"
 #include "lightmenu.h"
+#include "menu_window.h"
+
+static void prepare(uint8_t dirty);
+static uint16_t all_count(void);
+static int16_t all_height(uint16_t row);
+static void all_draw(GContext *ctx, const Layer *cell_layer, uint16_t row);
+static void all_select(uint16_t row);
+static void all_select_long(uint16_t row);
+static uint16_t lights_count(void);
+static const char* lights_label(uint16_t row);
+static const char* lights_value(uint16_t row);
+static void lights_select(uint16_t row);
+static void lights_select_long(uint16_t row);
+static uint16_t tags_count(void);
+static const char* tags_label(uint16_t row);
+static const char* tags_value(uint16_t row);
+static void tags_select(uint16_t row);
+static void tags_select_long(uint16_t row);
+static void other_select_long(uint16_t row);
+static void settings_open(int16_t value);
+static const MenuDescriptor* descriptor(void);
+
+static const GRect error_rect = { .origin = { 4, 2 }, .size = { PEBBLE_WIDTH - 8, 88 } };
+
+static int16_t error_height;
+
+static const MenuRow other_rows[] = {
+	{ "Settings", settings_open, 0 },
+};
+
+#define SECTION_ALL { .header = MENU_HEADER_NONE, .count = all_count, .height = all_height, .draw = all_draw, .select = all_select, .select_long = all_select_long }
+#define SECTION_LIGHTS { .header = MENU_HEADER_BASIC, .style = MENU_STYLE_LIST, .hide_empty = true, .title = "Lights", .count = lights_count, .label = lights_label, .value = lights_value, .select = lights_select, .select_long = lights_select_long }
+#define SECTION_TAGS { .header = MENU_HEADER_BASIC, .style = MENU_STYLE_LIST, .hide_empty = true, .title = "Tags", .count = tags_count, .label = tags_label, .value = tags_value, .select = tags_select, .select_long = tags_select_long }
+#define SECTION_OTHER { .header = MENU_HEADER_BASIC, .style = MENU_STYLE_LIST, .title = "Other", .rows = other_rows, .num_rows = ARRAY_LENGTH(other_rows), .select_long = other_select_long }
+
+static const MenuSection lights_first_sections[] = { SECTION_ALL, SECTION_LIGHTS, SECTION_TAGS, SECTION_OTHER };
+static const MenuSection tags_first_sections[] = { SECTION_ALL, SECTION_TAGS, SECTION_LIGHTS, SECTION_OTHER };
+
+static const MenuDescriptor lights_first = {
+	.sections = lights_first_sections,
+	.num_sections = ARRAY_LENGTH(lights_first_sections),
+	.cell_height = 30,
+	.depends = MENU_DIRTY_FLEET | MENU_DIRTY_ERROR | MENU_DIRTY_SETTINGS,
+	.prepare = prepare,
+};
+
+static const MenuDescriptor tags_first = {
+	.sections = tags_first_sections,
+	.num_sections = ARRAY_LENGTH(tags_first_sections),
+	.cell_height = 30,
+	.depends = MENU_DIRTY_FLEET | MENU_DIRTY_ERROR | MENU_DIRTY_SETTINGS,
+	.prepare = prepare,
+};
+
+static MenuWindow menu;
 
-#define MENU_NUM_SECTIONS 4
+void lightlist_init(void) {
+	menu_window_show(&menu, descriptor());
+}
 
-#define MENU_SECTION_ALL 0
-#define MENU_SECTION_OTHER 3
+void lightlist_deinit(void) {
+	settings_deinit();
+	lightmenu_deinit();
+	menu_window_deinit(&menu);
+}
 
-#define MENU_SECTION_ROWS_ALL 1
-#define MENU_SECTION_ROWS_OTHER 1
+void lightlist_update_settings(void) {
+	menu.descriptor = descriptor();
+}
 
-#define MENU_ROW_OTHER_SETTINGS 0
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
 
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static const MenuDescriptor* descriptor(void) {
+	return settings()->tags_first ? &tags_first : &lights_first;
+}
 
-static Window *window;
-static MenuLayer *menu_layer;
+static void light_select(uint8_t type, uint16_t row) {
+	selected_index = row;
+	selected_type = type;
+	lightmenu_show();
+}
 
-void lightlist_init(void) {
-	window = window_create();
+static void light_select_long(uint8_t type, uint16_t row) {
+	selected_index = row;
+	selected_type = type;
+	light_toggle();
+}
 
-	menu_layer = menu_layer_create_fullscreen(window);
-	menu_layer_set_callbacks(menu_layer, NULL, (MenuLayerCallbacks) {
-		.get_num_sections = menu_get_num_sections_callback,
-		.get_num_rows = menu_get_num_rows_callback,
-		.get_header_height = menu_get_header_height_callback,
-		.get_cell_height = menu_get_cell_height_callback,
-		.draw_header = menu_draw_header_callback,
-		.draw_row = menu_draw_row_callback,
-		.select_click = menu_select_callback,
-		.select_long_click = menu_select_long_callback,
-	});
-	menu_layer_set_click_config_onto_window(menu_layer, window);
-	menu_layer_add_to_window(menu_layer, window);
+// The error row is measured once per error rather than on every height query.
+static void prepare(uint8_t dirty) {
+	if (!(dirty & MENU_DIRTY_ERROR)) return;
+	error_height = error ? graphics_text_layout_get_content_size(error, menu_window_font(MENU_FONT_LABEL), error_rect, GTextOverflowModeFill, GTextAlignmentLeft).h + 10 : 30;
+}
 
-	window_stack_push(window, true);
+static uint16_t all_count(void) {
+	return 1;
+}
 
-	settings_init();
-	lightmenu_init();
+static int16_t all_height(uint16_t row) {
+	return error_height;
 }
 
-void lightlist_deinit(void) {
-	settings_deinit();
-	lightmenu_deinit();
-	menu_layer_destroy_safe(menu_layer);
-	window_destroy_safe(window);
+static void all_draw(GContext *ctx, const Layer *cell_layer, uint16_t row) {
+	if (error) {
+		graphics_draw_text(ctx, error, menu_window_font(MENU_FONT_LABEL), error_rect, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+	} else if (num_lights == 0) {
+		menu_window_draw_list_row(ctx, "Loading lights...", NULL);
+	} else {
+		menu_window_draw_list_row(ctx, light_label(all_lights), stale ? "..." : NULL);
+	}
 }
 
-void lightlist_reload_data_and_mark_dirty(void) {
-	menu_layer_reload_data_and_mark_dirty(menu_layer);
-	lightmenu_reload_data_and_mark_dirty();
+static void all_select(uint16_t row) {
+	if (num_lights == 0) return;
+	light_select(KEY_TYPE_ALL, row);
 }
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+static void all_select_long(uint16_t row) {
+	if (num_lights == 0) {
+		light_refresh();
+		return;
+	}
+	light_select_long(KEY_TYPE_ALL, row);
+}
 
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
-	return MENU_NUM_SECTIONS;
+static uint16_t lights_count(void) {
+	return settings()->hide_lights ? 0 : num_lights;
 }
 
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	if (section_index == MENU_SECTION_ALL) {
-		return MENU_SECTION_ROWS_ALL;
-	} else if (section_index == menu_section_lights) {
-		return num_lights;
-	} else if (section_index == menu_section_tags) {
-		return num_tags;
-	} else if (section_index == MENU_SECTION_OTHER) {
-		return MENU_SECTION_ROWS_OTHER;
-	} else {
-		return 0;
-	}
+static const char* lights_label(uint16_t row) {
+	return light_label(&lights[row]);
 }
 
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	if (section_index == menu_section_lights) {
-		return num_lights ? MENU_CELL_BASIC_HEADER_HEIGHT : 0;
-	} else if (section_index == menu_section_tags) {
-		return num_tags ? MENU_CELL_BASIC_HEADER_HEIGHT : 0;
-	} else if (section_index == MENU_SECTION_OTHER) {
-		return MENU_CELL_BASIC_HEADER_HEIGHT;
-	}
-	return 0;
-}
-
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	if (cell_index->section == MENU_SECTION_ALL) {
-		if (error) {
-			return graphics_text_layout_get_content_size(error, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { PEBBLE_WIDTH - 8, 88 } }, GTextOverflowModeFill, GTextAlignmentLeft).h + 10;
-		}
-		return 30;
-	} else if (cell_index->section == menu_section_lights) {
-		return 30;
-	} else if (cell_index->section == menu_section_tags) {
-		return 30;
-	} else if (cell_index->section == MENU_SECTION_OTHER) {
-		return 30;
-	} else {
-		return 0;
-	}
+static const char* lights_value(uint16_t row) {
+	return light_state(&lights[row]);
 }
 
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
-	if (section_index == menu_section_lights && num_lights) {
-		menu_cell_basic_header_draw(ctx, cell_layer, "Lights");
-	} else if (section_index == menu_section_tags && num_tags) {
-		menu_cell_basic_header_draw(ctx, cell_layer, "Tags");
-	} else if (section_index == MENU_SECTION_OTHER) {
-		menu_cell_basic_header_draw(ctx, cell_layer, "Other");
-	}
+static void lights_select(uint16_t row) {
+	light_select(KEY_TYPE_LIGHT, row);
 }
 
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
-	graphics_context_set_text_color(ctx, GColorBlack);
-	if (cell_index->section == MENU_SECTION_ALL) {
-		if (error) {
-			graphics_draw_text(ctx, error, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { PEBBLE_WIDTH - 8, 88 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-		} else if (num_lights == 0) {
-			graphics_draw_text(ctx, "Loading lights...", fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { PEBBLE_WIDTH - 8, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-		} else {
-			graphics_draw_text(ctx, all_lights->label, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { PEBBLE_WIDTH - 8, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-		}
-	} else if (cell_index->section == menu_section_lights) {
-		graphics_draw_text(ctx, lights[cell_index->row].label, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { 100, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-		graphics_draw_text(ctx, lights[cell_index->row].state, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), (GRect) { .origin = { 110, -3 }, .size = { 30, 26 } }, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
-	} else if (cell_index->section == menu_section_tags) {
-		graphics_draw_text(ctx, tags[cell_index->row].label, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { 100, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-		graphics_draw_text(ctx, tags[cell_index->row].state, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), (GRect) { .origin = { 110, -3 }, .size = { 30, 26 } }, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
-	} else if (cell_index->section == MENU_SECTION_OTHER) {
-		graphics_draw_text(ctx, "Settings", fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { PEBBLE_WIDTH - 8, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-	}
+static void lights_select_long(uint16_t row) {
+	light_select_long(KEY_TYPE_LIGHT, row);
 }
 
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	if (cell_index->section == MENU_SECTION_ALL) {
-		if (num_lights == 0) return;
-		selected_index = cell_index->row;
-		selected_type = KEY_TYPE_ALL;
-		lightmenu_show();
-	} else if (cell_index->section == menu_section_lights) {
-		selected_index = cell_index->row;
-		selected_type = KEY_TYPE_LIGHT;
-		lightmenu_show();
-	} else if (cell_index->section == menu_section_tags) {
-		selected_index = cell_index->row;
-		selected_type = KEY_TYPE_TAG;
-		lightmenu_show();
-	} else if (cell_index->section == MENU_SECTION_OTHER) {
-		settings_show();
-	}
+static uint16_t tags_count(void) {
+	return settings()->hide_tags ? 0 : num_tags;
 }
 
-static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	if (cell_index->section == MENU_SECTION_ALL) {
-		if (num_lights == 0) {
-			light_refresh();
-			return;
-		}
-		selected_index = cell_index->row;
-		selected_type = KEY_TYPE_ALL;
-		light_toggle();
-	} else if (cell_index->section == menu_section_lights) {
-		selected_index = cell_index->row;
-		selected_type = KEY_TYPE_LIGHT;
-		light_toggle();
-	} else if (cell_index->section == menu_section_tags) {
-		selected_index = cell_index->row;
-		selected_type = KEY_TYPE_TAG;
-		light_toggle();
-	} else if (cell_index->section == MENU_SECTION_OTHER) {
-		light_refresh();
-	}
+static const char* tags_label(uint16_t row) {
+	return light_label(&tags[row]);
+}
+
+static const char* tags_value(uint16_t row) {
+	return light_state(&tags[row]);
+}
+
+static void tags_select(uint16_t row) {
+	light_select(KEY_TYPE_TAG, row);
+}
+
+static void tags_select_long(uint16_t row) {
+	light_select_long(KEY_TYPE_TAG, row);
+}
+
+static void other_select_long(uint16_t row) {
+	light_refresh();
+}
+
+static void settings_open(int16_t value) {
+	settings_show();
 }
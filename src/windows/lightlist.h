@@ -2,4 +2,4 @@
 
 void lightlist_init(void);
 void lightlist_deinit(void);
-void lightlist_reload_data_and_mark_dirty(void);
+void lightlist_update_settings(void);
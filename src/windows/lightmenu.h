@@ -1,6 +1,4 @@
 #pragma once
 
-void lightmenu_init(void);
 void lightmenu_show(void);
 void lightmenu_deinit(void);
-void lightmenu_reload_data_and_mark_dirty(void);
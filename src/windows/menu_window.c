@@ -0,0 +1,240 @@
+#include <pebble.h>
+#include "menu_window.h"
+#include "../libs/pebble-assist.h"
+#include "../light.h"
+
+static void window_load(Window *window);
+static void window_appear(Window *window);
+static void window_unload(Window *window);
+static void mark(uint8_t what);
+static void schedule(uint32_t timeout);
+static void flush(void *data);
+static void reload(MenuWindow *menu);
+static uint16_t num_rows(const MenuSection *section);
+static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
+static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
+static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+
+#define MENU_WINDOWS_MAX 8
+
+// Reloads wait for the next frame, or for the end of a batch of data messages.
+#define MENU_FRAME_MS 33
+#define MENU_BATCH_MS 500
+
+#define SECTION(context, index) (&((MenuWindow*) context)->descriptor->sections[index])
+
+static const GRect item_rect = { .origin = { 4, 0 }, .size = { PEBBLE_WIDTH - 8, 28 } };
+static const GRect label_rect = { .origin = { 4, 2 }, .size = { 100, 22 } };
+static const GRect label_wide_rect = { .origin = { 4, 2 }, .size = { PEBBLE_WIDTH - 8, 22 } };
+static const GRect value_rect = { .origin = { 110, -3 }, .size = { 30, 26 } };
+static const GRect small_header_rect = { .origin = { 4, 0 }, .size = { 60, 18 } };
+
+static GFont fonts[MENU_FONT_COUNT];
+static MenuWindow *windows[MENU_WINDOWS_MAX];
+static AppTimer *flush_timer;
+static uint32_t flush_timeout;
+
+void menu_window_show(MenuWindow *menu, const MenuDescriptor *descriptor) {
+	if (!fonts[MENU_FONT_SMALL]) {
+		fonts[MENU_FONT_SMALL] = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD);
+		fonts[MENU_FONT_LABEL] = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
+		fonts[MENU_FONT_VALUE] = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
+	}
+	menu->descriptor = descriptor;
+	if (!menu->window) {
+		menu->window = window_create();
+		window_set_user_data(menu->window, menu);
+		window_set_window_handlers(menu->window, (WindowHandlers) {
+			.load = window_load,
+			.appear = window_appear,
+			.unload = window_unload,
+		});
+	}
+	window_stack_push(menu->window, true);
+}
+
+void menu_window_deinit(MenuWindow *menu) {
+	if (menu->window) window_stack_remove(menu->window, false);
+}
+
+void menu_window_invalidate(uint8_t what) {
+	mark(what);
+	schedule(MENU_FRAME_MS);
+}
+
+void menu_window_defer(uint8_t what) {
+	mark(what);
+	schedule(MENU_BATCH_MS);
+}
+
+// A label with an optional value on the right, for sections that draw their own rows.
+void menu_window_draw_list_row(GContext *ctx, const char *label, const char *value) {
+	graphics_draw_text(ctx, label, fonts[MENU_FONT_LABEL], value ? label_rect : label_wide_rect, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+	if (value) {
+		graphics_draw_text(ctx, value, fonts[MENU_FONT_VALUE], value_rect, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
+	}
+}
+
+GFont menu_window_font(uint8_t font) {
+	return fonts[font];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static void window_load(Window *window) {
+	MenuWindow *menu = window_get_user_data(window);
+	if (menu->descriptor->prepare) menu->descriptor->prepare(0xff);
+	menu->menu_layer = menu_layer_create_fullscreen(window);
+	menu_layer_set_callbacks(menu->menu_layer, menu, (MenuLayerCallbacks) {
+		.get_num_sections = menu_get_num_sections_callback,
+		.get_num_rows = menu_get_num_rows_callback,
+		.get_header_height = menu_get_header_height_callback,
+		.get_cell_height = menu_get_cell_height_callback,
+		.draw_header = menu_draw_header_callback,
+		.draw_row = menu_draw_row_callback,
+		.select_click = menu_select_callback,
+		.select_long_click = menu_select_long_callback,
+	});
+	menu_layer_set_click_config_onto_window(menu->menu_layer, window);
+	menu_layer_add_to_window(menu->menu_layer, window);
+	menu->dirty = 0;
+	for (uint8_t i = 0; i < MENU_WINDOWS_MAX; i++) {
+		if (!windows[i]) {
+			windows[i] = menu;
+			break;
+		}
+	}
+}
+
+static void window_appear(Window *window) {
+	reload(window_get_user_data(window));
+}
+
+static void window_unload(Window *window) {
+	MenuWindow *menu = window_get_user_data(window);
+	for (uint8_t i = 0; i < MENU_WINDOWS_MAX; i++) {
+		if (windows[i] == menu) windows[i] = NULL;
+	}
+	if (menu->descriptor->unload) menu->descriptor->unload();
+	menu_layer_destroy_safe(menu->menu_layer);
+	menu->menu_layer = NULL;
+	window_destroy(window);
+	menu->window = NULL;
+}
+
+static void mark(uint8_t what) {
+	for (uint8_t i = 0; i < MENU_WINDOWS_MAX; i++) {
+		if (windows[i]) windows[i]->dirty |= what & windows[i]->descriptor->depends;
+	}
+}
+
+static void schedule(uint32_t timeout) {
+	if (flush_timer && timeout >= flush_timeout) return;
+	app_timer_cancel_safe(flush_timer);
+	flush_timer = app_timer_register(timeout, flush, NULL);
+	flush_timeout = timeout;
+}
+
+// Only the window on screen is reloaded; the others catch up when they appear again.
+static void flush(void *data) {
+	flush_timer = NULL;
+	Window *top = window_stack_get_top_window();
+	for (uint8_t i = 0; i < MENU_WINDOWS_MAX; i++) {
+		if (windows[i] && windows[i]->window == top) reload(windows[i]);
+	}
+}
+
+static void reload(MenuWindow *menu) {
+	if (!menu->dirty || !menu->menu_layer) return;
+	if (menu->descriptor->prepare) menu->descriptor->prepare(menu->dirty);
+	menu->dirty = 0;
+	menu_layer_reload_data_and_mark_dirty(menu->menu_layer);
+}
+
+static uint16_t num_rows(const MenuSection *section) {
+	return section->count ? section->count() : section->num_rows;
+}
+
+static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
+	return ((MenuWindow*) callback_context)->descriptor->num_sections;
+}
+
+static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
+	return num_rows(SECTION(callback_context, section_index));
+}
+
+static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
+	const MenuSection *section = SECTION(callback_context, section_index);
+	if (section->hide_empty && num_rows(section) == 0) return 0;
+	switch (section->header) {
+		case MENU_HEADER_STATUS:
+			return 28;
+		case MENU_HEADER_BASIC:
+			return MENU_CELL_BASIC_HEADER_HEIGHT;
+		case MENU_HEADER_SMALL:
+			return 18;
+	}
+	return 0;
+}
+
+static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+	const MenuSection *section = SECTION(callback_context, cell_index->section);
+	return section->height ? section->height(cell_index->row) : ((MenuWindow*) callback_context)->descriptor->cell_height;
+}
+
+static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
+	const MenuSection *section = SECTION(callback_context, section_index);
+	if (section->hide_empty && num_rows(section) == 0) return;
+	graphics_context_set_text_color(ctx, GColorBlack);
+	switch (section->header) {
+		case MENU_HEADER_STATUS:
+			graphics_draw_text(ctx, light_label(light()), fonts[MENU_FONT_LABEL], label_rect, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+			graphics_draw_text(ctx, light_state(light()), fonts[MENU_FONT_VALUE], value_rect, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
+			break;
+		case MENU_HEADER_BASIC:
+			menu_cell_basic_header_draw(ctx, cell_layer, section->title);
+			break;
+		case MENU_HEADER_SMALL:
+			graphics_draw_text(ctx, section->title, fonts[MENU_FONT_SMALL], small_header_rect, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+			break;
+	}
+}
+
+static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
+	const MenuSection *section = SECTION(callback_context, cell_index->section);
+	graphics_context_set_text_color(ctx, GColorBlack);
+	if (section->draw) {
+		section->draw(ctx, cell_layer, cell_index->row);
+		return;
+	}
+	const char *label = section->rows ? section->rows[cell_index->row].label : section->label(cell_index->row);
+	const char *value = section->value ? section->value(cell_index->row) : NULL;
+	switch (section->style) {
+		case MENU_STYLE_ITEM:
+			graphics_draw_text(ctx, label, fonts[MENU_FONT_VALUE], item_rect, GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+			break;
+		case MENU_STYLE_LIST:
+			menu_window_draw_list_row(ctx, label, value);
+			break;
+	}
+}
+
+static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+	const MenuSection *section = SECTION(callback_context, cell_index->section);
+	if (section->rows) {
+		const MenuRow *row = &section->rows[cell_index->row];
+		if (row->action) row->action(row->value);
+	} else if (section->select) {
+		section->select(cell_index->row);
+	}
+}
+
+static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+	const MenuSection *section = SECTION(callback_context, cell_index->section);
+	if (section->select_long) section->select_long(cell_index->row);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+enum {
+	MENU_HEADER_NONE,
+	MENU_HEADER_STATUS,
+	MENU_HEADER_BASIC,
+	MENU_HEADER_SMALL,
+};
+
+// What a window shows; data changes mark only the windows that depend on them.
+enum {
+	MENU_DIRTY_FLEET = 1 << 0,
+	MENU_DIRTY_ERROR = 1 << 1,
+	MENU_DIRTY_SETTINGS = 1 << 2,
+	MENU_DIRTY_SCENES = 1 << 3,
+	MENU_DIRTY_PALETTE = 1 << 4,
+};
+
+enum {
+	MENU_FONT_SMALL,
+	MENU_FONT_LABEL,
+	MENU_FONT_VALUE,
+	MENU_FONT_COUNT,
+};
+
+enum {
+	MENU_STYLE_ITEM,
+	MENU_STYLE_LIST,
+};
+
+typedef struct {
+	const char *label;
+	void (*action)(int16_t value);
+	int16_t value;
+} MenuRow;
+
+// A section either lists const rows or builds them from data through the hooks.
+typedef struct {
+	uint8_t header;
+	uint8_t style;
+	bool hide_empty;
+	const char *title;
+	const MenuRow *rows;
+	uint16_t num_rows;
+	uint16_t (*count)(void);
+	const char* (*label)(uint16_t row);
+	const char* (*value)(uint16_t row);
+	void (*draw)(GContext *ctx, const Layer *cell_layer, uint16_t row);
+	int16_t (*height)(uint16_t row);
+	void (*select)(uint16_t row);
+	void (*select_long)(uint16_t row);
+} MenuSection;
+
+typedef struct {
+	const MenuSection *sections;
+	uint8_t num_sections;
+	int16_t cell_height;
+	uint8_t depends;
+	// Runs before a reload with the dirty bits, so row callbacks only draw what it prepared.
+	void (*prepare)(uint8_t dirty);
+	void (*unload)(void);
+} MenuDescriptor;
+
+typedef struct {
+	Window *window;
+	MenuLayer *menu_layer;
+	const MenuDescriptor *descriptor;
+	uint8_t dirty;
+} MenuWindow;
+
+void menu_window_show(MenuWindow *menu, const MenuDescriptor *descriptor);
+void menu_window_deinit(MenuWindow *menu);
+void menu_window_invalidate(uint8_t what);
+void menu_window_defer(uint8_t what);
+void menu_window_draw_list_row(GContext *ctx, const char *label, const char *value);
+GFont menu_window_font(uint8_t font);
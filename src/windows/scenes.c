@@ -0,0 +1,71 @@
+#include <pebble.h>
+#include "scenes.h"
+#include "../libs/pebble-assist.h"
+#include "../common.h"
+#include "../light.h"
+#include "../scene.h"
+#include "menu_window.h"
+
+static void save(int16_t value);
+static uint16_t scenes_count(void);
+static const char* scenes_label(uint16_t row);
+static void scenes_select(uint16_t row);
+static void scenes_select_long(uint16_t row);
+
+static const MenuRow save_rows[] = {
+	{ "Save as scene", save, 0 },
+};
+
+// Select restores a scene; a long press saves the current light over it.
+static const MenuSection sections[] = {
+	{ .header = MENU_HEADER_STATUS },
+	{ .header = MENU_HEADER_NONE, .rows = save_rows, .num_rows = ARRAY_LENGTH(save_rows) },
+	{ .header = MENU_HEADER_BASIC, .hide_empty = true, .title = "Scenes", .count = scenes_count, .label = scenes_label, .select = scenes_select, .select_long = scenes_select_long },
+};
+
+static const MenuDescriptor descriptor = {
+	.sections = sections,
+	.num_sections = ARRAY_LENGTH(sections),
+	.cell_height = 36,
+	.depends = MENU_DIRTY_FLEET | MENU_DIRTY_SCENES,
+};
+
+static MenuWindow menu;
+
+void scenes_show(void) {
+	menu_window_show(&menu, &descriptor);
+}
+
+void scenes_deinit(void) {
+	menu_window_deinit(&menu);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static void save(int16_t value) {
+	if (!scene_capture()) {
+		vibes_short_pulse();
+		return;
+	}
+	menu_window_invalidate(MENU_DIRTY_SCENES);
+}
+
+static uint16_t scenes_count(void) {
+	return scene_count();
+}
+
+static const char* scenes_label(uint16_t row) {
+	return scene_label(row);
+}
+
+static void scenes_select(uint16_t row) {
+	if (!scene_restore(row)) vibes_short_pulse();
+}
+
+static void scenes_select_long(uint16_t row) {
+	if (!scene_replace(row)) {
+		vibes_short_pulse();
+		return;
+	}
+	menu_window_invalidate(MENU_DIRTY_SCENES);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+void scenes_show(void);
+void scenes_deinit(void);
@@ -4,113 +4,62 @@
 #include "../common.h"
 #include "../settings.h"
 #include "../light.h"
+#include "menu_window.h"
 
-#define MENU_NUM_SECTIONS 1
+static const char* setting_value(uint16_t row);
+static void setting_toggle(int16_t value);
 
-#define MENU_SECTION_ROWS 3
+enum {
+	HIDE_LIGHTS,
+	HIDE_TAGS,
+	TAGS_FIRST,
+};
 
-#define MENU_ROW_HIDE_LIGHTS 0
-#define MENU_ROW_HIDE_TAGS 1
-#define MENU_ROW_TAGS_FIRST 2
+static const MenuRow rows[] = {
+	{ "Hide lights", setting_toggle, HIDE_LIGHTS },
+	{ "Hide tags", setting_toggle, HIDE_TAGS },
+	{ "Tags first", setting_toggle, TAGS_FIRST },
+};
 
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
-static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static const MenuSection sections[] = {
+	{ .header = MENU_HEADER_BASIC, .style = MENU_STYLE_LIST, .title = "Settings", .rows = rows, .num_rows = ARRAY_LENGTH(rows), .value = setting_value },
+};
 
-static Window *window;
-static MenuLayer *menu_layer;
+static const MenuDescriptor descriptor = {
+	.sections = sections,
+	.num_sections = ARRAY_LENGTH(sections),
+	.cell_height = 30,
+	.depends = MENU_DIRTY_SETTINGS,
+};
 
-void settings_init(void) {
-	window = window_create();
-
-	menu_layer = menu_layer_create_fullscreen(window);
-	menu_layer_set_callbacks(menu_layer, NULL, (MenuLayerCallbacks) {
-		.get_num_sections = menu_get_num_sections_callback,
-		.get_num_rows = menu_get_num_rows_callback,
-		.get_header_height = menu_get_header_height_callback,
-		.get_cell_height = menu_get_cell_height_callback,
-		.draw_header = menu_draw_header_callback,
-		.draw_row = menu_draw_row_callback,
-		.select_click = menu_select_callback,
-		.select_long_click = menu_select_long_callback,
-	});
-	menu_layer_set_click_config_onto_window(menu_layer, window);
-	menu_layer_add_to_window(menu_layer, window);
-}
+static MenuWindow menu;
 
 void settings_show(void) {
-	window_stack_push(window, true);
+	menu_window_show(&menu, &descriptor);
 }
 
 void settings_deinit(void) {
-	menu_layer_destroy_safe(menu_layer);
-	window_destroy_safe(window);
+	menu_window_deinit(&menu);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
 
-static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
-	return MENU_NUM_SECTIONS;
-}
-
-static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	return MENU_SECTION_ROWS;
-}
-
-static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	return MENU_CELL_BASIC_HEADER_HEIGHT;
-}
-
-static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	return 30;
-}
-
-static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
-	menu_cell_basic_header_draw(ctx, cell_layer, "Settings");
-}
-
-static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
-	char label[16] = "";
-	char value[6] = "";
-	switch (cell_index->row) {
-		case MENU_ROW_HIDE_LIGHTS:
-			strcpy(label, "Hide lights");
-			strcpy(value, settings()->hide_lights ? "YES": "NO");
-			break;
-		case MENU_ROW_HIDE_TAGS:
-			strcpy(label, "Hide tags");
-			strcpy(value, settings()->hide_tags ? "YES": "NO");
-			break;
-		case MENU_ROW_TAGS_FIRST:
-			strcpy(label, "Tags first");
-			strcpy(value, settings()->tags_first ? "YES": "NO");
-			break;
+static bool* setting(uint16_t which) {
+	switch (which) {
+		case HIDE_LIGHTS:
+			return &settings()->hide_lights;
+		case HIDE_TAGS:
+			return &settings()->hide_tags;
+		default:
+			return &settings()->tags_first;
 	}
-	graphics_context_set_text_color(ctx, GColorBlack);
-	graphics_draw_text(ctx, label, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), (GRect) { .origin = { 4, 2 }, .size = { 100, 22 } }, GTextOverflowModeFill, GTextAlignmentLeft, NULL);
-	graphics_draw_text(ctx, value, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), (GRect) { .origin = { 110, -3 }, .size = { 30, 26 } }, GTextOverflowModeFill, GTextAlignmentCenter, NULL);
 }
 
-static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-	switch (cell_index->row) {
-		case MENU_ROW_HIDE_LIGHTS:
-			settings()->hide_lights = ! settings()->hide_lights;
-			break;
-		case MENU_ROW_HIDE_TAGS:
-			settings()->hide_tags = ! settings()->hide_tags;
-			break;
-		case MENU_ROW_TAGS_FIRST:
-			settings()->tags_first = ! settings()->tags_first;
-			break;
-	}
-	menu_layer_reload_data(menu_layer);
-	light_update_settings();
+static const char* setting_value(uint16_t row) {
+	return *setting(rows[row].value) ? "YES" : "NO";
 }
 
-static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+static void setting_toggle(int16_t value) {
+	*setting(value) = ! *setting(value);
+	light_update_settings();
 }
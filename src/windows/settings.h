@@ -1,5 +1,4 @@
 #pragma once
 
-void settings_init(void);
 void settings_show(void);
 void settings_deinit(void);
@@ -0,0 +1,160 @@
+#include <pebble.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+#include "../../src/appmessage.h"
+#include "../../src/common.h"
+#include "../../src/settings.h"
+#include "../../src/cache.h"
+#include "../../src/scene.h"
+#include "../../src/palette.h"
+#include "../../src/light.h"
+
+// Feeds the watch code PATCH streams like the JS would send them and reports
+// what each stream costs. Every fleet size runs in its own process so the
+// app starts from scratch each time.
+
+#undef malloc
+#undef free
+
+#define INBOX_SIZE 656
+#define MESSAGE_INTERVAL 40
+#define UPDATES 50
+
+static const uint16_t sizes[] = { 1, 8, 32, 64, 128, 255 };
+
+typedef struct {
+	uint8_t buffer[INBOX_SIZE];
+	DictionaryIterator iter;
+	uint8_t count;
+	uint16_t used;
+	uint8_t records[INBOX_SIZE];
+} Patch;
+
+static uint64_t clock_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+// PebbleKit JS sends every number as a 4 byte int.
+static void write_int(DictionaryIterator *iter, uint32_t key, int32_t value) {
+	dict_write_int32(iter, key, value);
+}
+
+static uint16_t record(uint8_t *data, uint8_t index, const char *prefix, uint8_t hue) {
+	char label[32];
+	uint8_t length = snprintf(label, sizeof(label), "%s %d", prefix, index + 1);
+	data[RECORD_INDEX] = index;
+	data[RECORD_FLAGS] = index % 2 ? RECORD_FLAG_ON : 0;
+	data[RECORD_HUE] = hue;
+	data[RECORD_SATURATION] = 100;
+	data[RECORD_BRIGHTNESS] = 80;
+	data[RECORD_KELVIN] = 3500 & 0xff;
+	data[RECORD_KELVIN + 1] = 3500 >> 8;
+	data[RECORD_LABEL_LENGTH] = length;
+	memcpy(&data[RECORD_LABEL], label, length);
+	return RECORD_LABEL + length;
+}
+
+// Header tuples: type, method, index, count and version at 11 bytes each, plus the data tuple header.
+static uint16_t patch_room(void) {
+	return INBOX_SIZE - 1 - 5 * 11 - 7;
+}
+
+static void patch_send(Patch *patch, uint8_t type, uint8_t total, uint32_t version) {
+	patch->buffer[0] = 0;
+	patch->iter.dictionary = patch->buffer;
+	patch->iter.cursor = (Tuple *) &patch->buffer[1];
+	patch->iter.end = patch->iter.cursor;
+	write_int(&patch->iter, KEY_TYPE, type);
+	write_int(&patch->iter, KEY_METHOD, KEY_METHOD_PATCH);
+	write_int(&patch->iter, KEY_INDEX, total);
+	write_int(&patch->iter, KEY_COUNT, patch->count);
+	if (patch->count) dict_write_data(&patch->iter, KEY_DATA, patch->records, patch->used);
+	if (version) dict_write_uint32(&patch->iter, KEY_VERSION, version);
+	dict_write_end(&patch->iter);
+	bench_receive(&patch->iter);
+	bench_advance(MESSAGE_INTERVAL);
+	bench_render();
+	patch->count = 0;
+	patch->used = 0;
+}
+
+// One full sync of a list, packed greedily like LIFX.sendPatch.
+static void sync_list(uint8_t type, uint8_t total, const char *prefix, uint32_t version) {
+	static Patch patch;
+	uint8_t data[RECORD_LABEL + 32];
+	for (uint16_t i = 0; i < total; i++) {
+		uint16_t length = record(data, i, prefix, i % 100);
+		if (patch.count && patch.used + length > patch_room()) patch_send(&patch, type, total, 0);
+		memcpy(&patch.records[patch.used], data, length);
+		patch.used += length;
+		patch.count++;
+	}
+	patch_send(&patch, type, total, version);
+}
+
+static void app_init(void) {
+	appmessage_init();
+	settings_load();
+	scene_load();
+	palette_load();
+	cache_load();
+	light_init();
+	bench_advance(MESSAGE_INTERVAL);
+	bench_render();
+}
+
+static void report(const char *phase, uint16_t lights, uint64_t us, uint32_t steps) {
+	printf("%-6s %5d %9llu %9.1f %6u %6u %8u %7u %7u %7zu %7zu\n", phase, lights,
+		(unsigned long long) us, steps ? (double) us / steps : 0.0,
+		bench_stats.messages_in, bench_stats.messages_out, bench_stats.reloads, bench_stats.renders,
+		bench_stats.rows_drawn, bench_stats.heap_peak, bench_stats.heap_used);
+}
+
+static void run(uint16_t num) {
+	uint8_t num_tags = num / 8 + 1;
+	app_init();
+
+	bench_reset_stats();
+	uint64_t start = clock_us();
+	sync_list(KEY_TYPE_LIGHT, num, "Light", 1);
+	sync_list(KEY_TYPE_TAG, num_tags, "Tag", 2);
+	bench_advance(1000);
+	bench_render();
+	report("sync", num, clock_us() - start, bench_stats.messages_in);
+
+	bench_reset_stats();
+	start = clock_us();
+	static Patch patch;
+	for (uint32_t i = 0; i < UPDATES; i++) {
+		patch.used = record(patch.records, i % num, "Light", (i * 7) % 100);
+		patch.count = 1;
+		patch_send(&patch, KEY_TYPE_LIGHT, num, 3 + i);
+	}
+	bench_advance(1000);
+	bench_render();
+	report("update", num, clock_us() - start, UPDATES);
+
+	light_deinit();
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	printf("%-6s %5s %9s %9s %6s %6s %8s %7s %7s %7s %7s\n", "phase", "n", "us", "us/msg", "in", "out", "reloads", "renders", "rows", "peak", "heap");
+	for (uint8_t i = 0; i < ARRAY_LENGTH(sizes); i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			run(sizes[i]);
+			_exit(0);
+		}
+		int status;
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			fprintf(stderr, "bench: %d lights failed\n", sizes[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Controls for the fake SDK in fake.c.
+
+typedef struct {
+	uint32_t messages_in;
+	uint32_t messages_out;
+	uint32_t reloads;
+	uint32_t renders;
+	uint32_t rows_drawn;
+	size_t heap_used;
+	size_t heap_peak;
+} BenchStats;
+
+extern BenchStats bench_stats;
+
+void bench_reset_stats(void);
+void bench_receive(DictionaryIterator *iter);
+void bench_advance(uint32_t ms);
+void bench_render(void);
+uint32_t bench_now(void);
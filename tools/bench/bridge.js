@@ -0,0 +1,262 @@
+// Runs pebble-js-app.js in Node against a fake Pebble runtime, a fake lifx-http and a virtual clock,
+// and reports what the connect, refresh, toggle and color flows cost at several fleet sizes.
+//
+//   node tools/bench/bridge.js [--sizes 1,10,50,100,250,500] [--ack 30] [--nack 0.05] [--http 40] [--seed 1]
+//
+// --ack is the watch's ack latency and --http lifx-http's response time, both in ms; --nack is the
+// share of AppMessages the watch refuses as busy. Times are virtual ms from the first message of a
+// flow until the bridge is idle again, plus the host CPU ms it took. The watch column is how many
+// lights the watch was last told about; it tops out at 255, as light indexes are single bytes. Set
+// BRIDGE_LOG=1 for the bridge's own logging.
+
+var fs = require('fs');
+var path = require('path');
+var vm = require('vm');
+
+var SOURCE = path.join(__dirname, '..', '..', 'src', 'js', 'pebble-js-app.js');
+var TAG_SIZE = 8;
+
+var options = {
+	sizes: [1, 10, 50, 100, 250, 500],
+	ack: 30,
+	nack: 0,
+	http: 40,
+	seed: 1
+};
+
+var parseArgs = function(argv) {
+	for (var i = 0; i < argv.length; i += 2) {
+		var name = argv[i].replace(/^--/, '');
+		if (!options.hasOwnProperty(name) || i + 1 >= argv.length) {
+			console.error('Unknown option ' + argv[i]);
+			process.exit(1);
+		}
+		options[name] = name == 'sizes' ? argv[i + 1].split(',').map(Number) : Number(argv[i + 1]);
+	}
+};
+
+// A small seeded generator, so nacks and backoff jitter repeat from run to run.
+var random = function(seed) {
+	var state = seed >>> 0 || 1;
+	return function() {
+		state ^= state << 13;
+		state ^= state >>> 17;
+		state ^= state << 5;
+		return (state >>> 0) / 4294967296;
+	};
+};
+
+// Timers ordered by due time and then by creation, all driven by run().
+var clock = function() {
+	return {
+		now: 1000000,
+		nextId: 1,
+		timers: {},
+		setTimeout: function(fn, delay) {
+			var id = this.nextId++;
+			this.timers[id] = {fn:fn, due:this.now + Math.max(0, delay || 0), id:id};
+			return id;
+		},
+		clearTimeout: function(id) {
+			delete this.timers[id];
+		},
+		next: function() {
+			var first = null;
+			for (var id in this.timers) {
+				var timer = this.timers[id];
+				if (!first || timer.due < first.due || timer.due == first.due && timer.id < first.id) first = timer;
+			}
+			return first;
+		},
+		// Fires timers until only those in ignore are left.
+		run: function(ignore) {
+			for (var timer = this.next(); timer; timer = this.next()) {
+				if (Object.keys(this.timers).every(function(id) { return ignore().indexOf(Number(id)) >= 0; })) return;
+				delete this.timers[timer.id];
+				this.now = Math.max(this.now, timer.due);
+				timer.fn();
+			}
+		}
+	};
+};
+
+// lifx-http with n lights, TAG_SIZE to a tag.
+var server = function(n) {
+	var lights = [];
+	for (var i = 0; i < n; i++) {
+		lights.push({
+			id: 'd073d5' + ('000000' + i.toString(16)).slice(-6),
+			label: 'Light ' + (i + 1),
+			on: i % 2 === 0,
+			tags: ['Room ' + (Math.floor(i / TAG_SIZE) + 1)],
+			color: {hue:120, saturation:0.5, brightness:0.8, kelvin:3500}
+		});
+	}
+	var select = function(selector) {
+		if (selector == 'all') return lights;
+		if (selector.substring(0, 4) == 'tag:') return lights.filter(function(light) { return light.tags.indexOf(selector.substring(4)) >= 0; });
+		return lights.filter(function(light) { return light.id == selector; });
+	};
+	return {
+		lights: lights,
+		handle: function(method, url, data) {
+			var match = /\/lights\/([^\/]*)(\/\w+)?$/.exec(url);
+			var selected = select(decodeURIComponent(match[1]));
+			var endpoint = match[2] || '';
+			selected.forEach(function(light) {
+				if (method != 'PUT') return;
+				if (endpoint == '/toggle') light.on = !light.on;
+				if (endpoint == '/on') light.on = true;
+				if (endpoint == '/off') light.on = false;
+				if (endpoint == '/color') {
+					var color = JSON.parse(data);
+					light.color = {hue:color.hue, saturation:color.saturation, brightness:color.brightness, kelvin:color.kelvin};
+				}
+			});
+			return JSON.stringify(selected.map(function(light) { return JSON.parse(JSON.stringify(light)); }));
+		}
+	};
+};
+
+// Encoded size of a message as the watch receives it, like appMessageSize in the bridge.
+var messageBytes = function(message) {
+	var size = 1;
+	for (var key in message) {
+		var value = message[key];
+		if (typeof value == 'string') size += 7 + Buffer.byteLength(value) + 1;
+		else if (Array.isArray(value)) size += 7 + value.length;
+		else size += 7 + 4;
+	}
+	return size;
+};
+
+var bridge = function(n) {
+	var time = clock();
+	var rand = random(options.seed);
+	var lifx = server(n);
+	var stats = {messages:0, bytes:0, nacks:0, http:0};
+	var pending = {acks:0, http:0};
+	var watchLights = 0;
+	var listeners = {};
+	var store = {};
+
+	var fakeMath = Object.create(Math);
+	fakeMath.random = rand;
+
+	var FakeDate = function(value) {
+		return value === undefined ? new Date(time.now) : new Date(value);
+	};
+	FakeDate.now = function() { return time.now; };
+
+	var XMLHttpRequest = function() {};
+	XMLHttpRequest.prototype = {
+		open: function(method, url) {
+			this.method = method;
+			this.url = url;
+		},
+		send: function(data) {
+			var xhr = this;
+			stats.http++;
+			pending.http++;
+			time.setTimeout(function() {
+				pending.http--;
+				xhr.status = 200;
+				xhr.responseText = lifx.handle(xhr.method, xhr.url, data);
+				if (xhr.onload) xhr.onload();
+			}, options.http);
+		},
+		abort: function() {}
+	};
+
+	var context = {
+		console: {log: function() { if (process.env.BRIDGE_LOG) console.log.apply(console, arguments); }},
+		localStorage: {
+			getItem: function(key) { return store.hasOwnProperty(key) ? store[key] : null; },
+			setItem: function(key, value) { store[key] = String(value); },
+			removeItem: function(key) { delete store[key]; }
+		},
+		setTimeout: time.setTimeout.bind(time),
+		clearTimeout: time.clearTimeout.bind(time),
+		Date: FakeDate,
+		Math: fakeMath,
+		XMLHttpRequest: XMLHttpRequest,
+		Pebble: {
+			addEventListener: function(name, listener) { listeners[name] = listener; },
+			openURL: function() {},
+			sendAppMessage: function(message, ack, nack) {
+				stats.messages++;
+				stats.bytes += messageBytes(message);
+				if (message.method == context.METHOD.PATCH && message.type == context.TYPE.LIGHT) watchLights = message.index;
+				pending.acks++;
+				var refused = rand() < options.nack;
+				if (refused) stats.nacks++;
+				time.setTimeout(function() {
+					pending.acks--;
+					if (refused) nack({data:{transactionId:stats.messages}, error:{message:'APP_MSG_BUSY'}});
+					else ack({data:{transactionId:stats.messages}});
+				}, options.ack);
+			}
+		}
+	};
+	vm.createContext(context);
+	vm.runInContext(fs.readFileSync(SOURCE, 'utf8'), context, {filename:SOURCE});
+
+	// The poller keeps a timer forever; everything else means the flow is still going.
+	var idle = function() {
+		return [context.poller.timer];
+	};
+
+	return {
+		// Runs a flow to completion and returns its counters.
+		measure: function(start) {
+			stats = {messages:0, bytes:0, nacks:0, http:0};
+			var begin = time.now;
+			var cpu = process.hrtime();
+			start();
+			time.run(idle);
+			cpu = process.hrtime(cpu);
+			if (pending.acks || pending.http) throw new Error('Bridge stopped with work outstanding');
+			stats.ms = time.now - begin;
+			stats.cpu = cpu[0] * 1000 + cpu[1] / 1e6;
+			stats.watch = watchLights;
+			return stats;
+		},
+		ready: function() {
+			listeners.ready({});
+			listeners.appmessage({payload:{method:context.METHOD.READY, protocol:context.PROTOCOL, session:1, inbox_size:656, outbox_size:656, palette:0}});
+		},
+		send: function(payload) {
+			listeners.appmessage({payload:payload});
+		},
+		METHOD: context.METHOD,
+		TYPE: context.TYPE
+	};
+};
+
+var row = function(cells) {
+	return cells.map(function(cell, i) {
+		var text = typeof cell == 'number' && cell % 1 ? cell.toFixed(1) : String(cell);
+		return i === 0 ? (text + '        ').slice(0, 8) : ('         ' + text).slice(-9);
+	}).join(' ');
+};
+
+var main = function() {
+	parseArgs(process.argv.slice(2));
+	console.log('ack ' + options.ack + ' ms, nack ' + options.nack + ', http ' + options.http + ' ms, seed ' + options.seed);
+	console.log(row(['flow', 'lights', 'watch', 'messages', 'bytes', 'nacks', 'http', 'ms', 'cpu ms']));
+	options.sizes.forEach(function(n) {
+		var phone = bridge(n);
+		var flows = [
+			['connect', function() { phone.ready(); }],
+			['refresh', function() { phone.send({method:phone.METHOD.REFRESH}); }],
+			['toggle', function() { phone.send({method:phone.METHOD.TOGGLE, type:phone.TYPE.ALL, index:0, operation:1}); }],
+			['color', function() { phone.send({method:phone.METHOD.COLOR, type:phone.TYPE.ALL, index:0, operation:2, color_h:30, color_s:80, color_b:60, color_k:3500}); }]
+		];
+		flows.forEach(function(flow) {
+			var stats = phone.measure(flow[1]);
+			console.log(row([flow[0], n, stats.watch, stats.messages, stats.bytes, stats.nacks, stats.http, stats.ms, stats.cpu]));
+		});
+	});
+};
+
+main();
@@ -0,0 +1,613 @@
+#include <pebble.h>
+#include <stdarg.h>
+#include "bench.h"
+
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+#define INBOX_SIZE 656
+#define OUTBOX_SIZE 656
+#define STACK_MAX 16
+#define PERSIST_MAX 32
+#define SCREEN { .origin = { 0, 0 }, .size = { 144, 168 } }
+
+BenchStats bench_stats;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Heap: a size header in front of every block.
+
+void *bench_malloc(size_t size) {
+	size_t *block = malloc(sizeof(size_t) + size);
+	if (!block) return NULL;
+	*block = size;
+	bench_stats.heap_used += size;
+	if (bench_stats.heap_used > bench_stats.heap_peak) bench_stats.heap_peak = bench_stats.heap_used;
+	return block + 1;
+}
+
+void *bench_calloc(size_t count, size_t size) {
+	void *ptr = bench_malloc(count * size);
+	if (ptr) memset(ptr, 0, count * size);
+	return ptr;
+}
+
+void bench_free(void *ptr) {
+	if (!ptr) return;
+	size_t *block = (size_t *) ptr - 1;
+	bench_stats.heap_used -= *block;
+	free(block);
+}
+
+void *bench_realloc(void *ptr, size_t size) {
+	void *copy = bench_malloc(size);
+	if (copy && ptr) {
+		size_t old = ((size_t *) ptr)[-1];
+		memcpy(copy, ptr, old < size ? old : size);
+	}
+	bench_free(ptr);
+	return copy;
+}
+
+size_t heap_bytes_used(void) {
+	return bench_stats.heap_used;
+}
+
+size_t heap_bytes_free(void) {
+	return 24 * 1024 - bench_stats.heap_used;
+}
+
+void bench_reset_stats(void) {
+	size_t used = bench_stats.heap_used;
+	memset(&bench_stats, 0, sizeof(bench_stats));
+	bench_stats.heap_used = used;
+	bench_stats.heap_peak = used;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Dictionaries: a count byte followed by packed tuples, as on the watch.
+
+static Tuple *first_tuple(const DictionaryIterator *iter) {
+	return (Tuple *) ((uint8_t *) iter->dictionary + 1);
+}
+
+static Tuple *next_tuple(const Tuple *tuple) {
+	return (Tuple *) ((uint8_t *) tuple + sizeof(Tuple) + tuple->length);
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+	for (Tuple *tuple = first_tuple(iter); (void *) tuple < iter->end; tuple = next_tuple(tuple)) {
+		if (tuple->key == key) return tuple;
+	}
+	return NULL;
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t * const buffer, const uint16_t size) {
+	iter->dictionary = (void *) buffer;
+	iter->end = buffer + size;
+	iter->cursor = first_tuple(iter);
+	return size > 1 ? iter->cursor : NULL;
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+	iter->cursor = first_tuple(iter);
+	return (void *) iter->cursor < iter->end ? iter->cursor : NULL;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+	iter->cursor = next_tuple(iter->cursor);
+	return (void *) iter->cursor < iter->end ? iter->cursor : NULL;
+}
+
+static DictionaryResult write(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data, uint16_t length) {
+	Tuple *tuple = iter->cursor;
+	tuple->key = key;
+	tuple->type = type;
+	tuple->length = length;
+	memcpy(tuple->value, data, length);
+	iter->cursor = next_tuple(tuple);
+	iter->end = iter->cursor;
+	((uint8_t *) iter->dictionary)[0]++;
+	return DICT_OK;
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+	return write(iter, key, TUPLE_UINT, &value, 1);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value) {
+	return write(iter, key, TUPLE_UINT, &value, 2);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+	return write(iter, key, TUPLE_UINT, &value, 4);
+}
+
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value) {
+	return write(iter, key, TUPLE_INT, &value, 1);
+}
+
+DictionaryResult dict_write_int16(DictionaryIterator *iter, const uint32_t key, const int16_t value) {
+	return write(iter, key, TUPLE_INT, &value, 2);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+	return write(iter, key, TUPLE_INT, &value, 4);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char * const cstring) {
+	return write(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1);
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data, const uint16_t size) {
+	return write(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+	return (uint8_t *) iter->end - (uint8_t *) iter->dictionary;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// AppMessage: the outbox is acknowledged on the next bench_advance().
+
+static AppMessageInboxReceived inbox_received;
+static AppMessageOutboxSent outbox_sent;
+static AppMessageOutboxFailed outbox_failed;
+static uint8_t outbox[OUTBOX_SIZE];
+static DictionaryIterator outbox_iter;
+static bool outbox_open;
+static bool outbox_in_flight;
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived handler) {
+	inbox_received = handler;
+	return NULL;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped handler) {
+	return NULL;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent handler) {
+	outbox_sent = handler;
+	return NULL;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed handler) {
+	outbox_failed = handler;
+	return NULL;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+	return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+	return INBOX_SIZE;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+	return OUTBOX_SIZE;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+	if (outbox_open || outbox_in_flight) return APP_MSG_BUSY;
+	outbox[0] = 0;
+	outbox_iter.dictionary = outbox;
+	outbox_iter.cursor = first_tuple(&outbox_iter);
+	outbox_iter.end = outbox_iter.cursor;
+	outbox_open = true;
+	*iterator = &outbox_iter;
+	return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+	if (!outbox_open) return APP_MSG_INVALID_ARGS;
+	outbox_open = false;
+	outbox_in_flight = true;
+	bench_stats.messages_out++;
+	return APP_MSG_OK;
+}
+
+void bench_receive(DictionaryIterator *iter) {
+	bench_stats.messages_in++;
+	if (inbox_received) inbox_received(iter, NULL);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Timers run on a fake clock that only bench_advance() moves.
+
+struct AppTimer {
+	uint32_t due;
+	AppTimerCallback callback;
+	void *data;
+	AppTimer *next;
+};
+
+static AppTimer *timers;
+static uint32_t now;
+
+uint32_t bench_now(void) {
+	return now;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+	AppTimer *timer = malloc(sizeof(AppTimer));
+	*timer = (AppTimer) { .due = now + timeout_ms, .callback = callback, .data = callback_data, .next = timers };
+	timers = timer;
+	return timer;
+}
+
+static bool unlink_timer(AppTimer *timer) {
+	for (AppTimer **link = &timers; *link; link = &(*link)->next) {
+		if (*link == timer) {
+			*link = timer->next;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+	for (AppTimer *timer = timers; timer; timer = timer->next) {
+		if (timer == timer_handle) {
+			timer->due = now + new_timeout_ms;
+			return true;
+		}
+	}
+	return false;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+	if (unlink_timer(timer_handle)) free(timer_handle);
+}
+
+void bench_advance(uint32_t ms) {
+	if (outbox_in_flight) {
+		outbox_in_flight = false;
+		DictionaryIterator sent = outbox_iter;
+		if (outbox_sent) outbox_sent(&sent, NULL);
+	}
+	uint32_t until = now + ms;
+	for (;;) {
+		AppTimer *first = NULL;
+		for (AppTimer *timer = timers; timer; timer = timer->next) {
+			if (timer->due <= until && (!first || timer->due < first->due)) first = timer;
+		}
+		if (!first) break;
+		unlink_timer(first);
+		if (first->due > now) now = first->due;
+		first->callback(first->data);
+		free(first);
+	}
+	now = until;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Persistent storage in memory.
+
+typedef struct {
+	uint32_t key;
+	int size;
+	uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistEntry;
+
+static PersistEntry persist[PERSIST_MAX];
+static uint8_t num_persist;
+
+static PersistEntry *persist_find(uint32_t key) {
+	for (uint8_t i = 0; i < num_persist; i++) {
+		if (persist[i].key == key) return &persist[i];
+	}
+	return NULL;
+}
+
+bool persist_exists(const uint32_t key) {
+	return persist_find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+	PersistEntry *entry = persist_find(key);
+	return entry ? entry->size : 0;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+	PersistEntry *entry = persist_find(key);
+	if (!entry) return 0;
+	int size = (size_t) entry->size < buffer_size ? entry->size : (int) buffer_size;
+	memcpy(buffer, entry->data, size);
+	return size;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+	PersistEntry *entry = persist_find(key);
+	if (!entry) {
+		if (num_persist == PERSIST_MAX) return 0;
+		entry = &persist[num_persist++];
+		entry->key = key;
+	}
+	entry->size = size < PERSIST_DATA_MAX_LENGTH ? size : PERSIST_DATA_MAX_LENGTH;
+	memcpy(entry->data, data, entry->size);
+	return entry->size;
+}
+
+int persist_delete(const uint32_t key) {
+	PersistEntry *entry = persist_find(key);
+	if (entry) *entry = persist[--num_persist];
+	return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Layers, windows and the window stack.
+
+struct Layer {
+	GRect frame;
+	bool dirty;
+	Layer *child;
+	MenuLayer *menu;
+};
+
+struct Window {
+	Layer root;
+	WindowHandlers handlers;
+	void *user_data;
+	bool loaded;
+};
+
+struct NumberWindow {
+	Window window;
+	int32_t value;
+};
+
+static Window *stack[STACK_MAX];
+static uint8_t stack_size;
+
+Layer *layer_create(GRect frame) {
+	Layer *layer = calloc(1, sizeof(Layer));
+	layer->frame = frame;
+	return layer;
+}
+
+void layer_destroy(Layer *layer) {
+	free(layer);
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+	return (GRect) { .origin = { 0, 0 }, .size = layer->frame.size };
+}
+
+GRect layer_get_frame(const Layer *layer) {
+	return layer->frame;
+}
+
+void layer_mark_dirty(Layer *layer) {
+	layer->dirty = true;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+	parent->child = child;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+}
+
+Window *window_create(void) {
+	Window *window = calloc(1, sizeof(Window));
+	window->root.frame = (GRect) SCREEN;
+	return window;
+}
+
+void window_destroy(Window *window) {
+	free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+	window->handlers = handlers;
+}
+
+void window_set_user_data(Window *window, void *data) {
+	window->user_data = data;
+}
+
+void *window_get_user_data(const Window *window) {
+	return window->user_data;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+	return (Layer *) &window->root;
+}
+
+bool window_is_loaded(Window *window) {
+	return window->loaded;
+}
+
+Window *window_stack_get_top_window(void) {
+	return stack_size ? stack[stack_size - 1] : NULL;
+}
+
+bool window_stack_contains_window(Window *window) {
+	for (uint8_t i = 0; i < stack_size; i++) {
+		if (stack[i] == window) return true;
+	}
+	return false;
+}
+
+void window_stack_push(Window *window, bool animated) {
+	Window *top = window_stack_get_top_window();
+	if (top && top->handlers.disappear) top->handlers.disappear(top);
+	stack[stack_size++] = window;
+	if (!window->loaded) {
+		window->loaded = true;
+		if (window->handlers.load) window->handlers.load(window);
+	}
+	if (window->handlers.appear) window->handlers.appear(window);
+	window->root.dirty = true;
+}
+
+Window *window_stack_remove(Window *window, bool animated) {
+	for (uint8_t i = 0; i < stack_size; i++) {
+		if (stack[i] != window) continue;
+		bool top = i == stack_size - 1;
+		memmove(&stack[i], &stack[i + 1], sizeof(Window *) * (stack_size - i - 1));
+		stack_size--;
+		if (top && window->handlers.disappear) window->handlers.disappear(window);
+		window->loaded = false;
+		if (window->handlers.unload) window->handlers.unload(window);
+		Window *uncovered = window_stack_get_top_window();
+		if (top && uncovered && uncovered->handlers.appear) uncovered->handlers.appear(uncovered);
+		return window;
+	}
+	return NULL;
+}
+
+Window *window_stack_pop(bool animated) {
+	Window *top = window_stack_get_top_window();
+	return top ? window_stack_remove(top, animated) : NULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// MenuLayer: bench_render() draws what fits on screen from the top.
+
+struct MenuLayer {
+	Layer layer;
+	MenuLayerCallbacks callbacks;
+	void *context;
+};
+
+MenuLayer *menu_layer_create(GRect frame) {
+	MenuLayer *menu_layer = calloc(1, sizeof(MenuLayer));
+	menu_layer->layer.frame = frame;
+	menu_layer->layer.menu = menu_layer;
+	return menu_layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+	free(menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+	return (Layer *) &menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+	menu_layer->callbacks = callbacks;
+	menu_layer->context = callback_context;
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, struct Window *window) {
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+	bench_stats.reloads++;
+	MenuLayerCallbacks *callbacks = &menu_layer->callbacks;
+	uint16_t sections = callbacks->get_num_sections ? callbacks->get_num_sections(menu_layer, menu_layer->context) : 1;
+	for (uint16_t section = 0; section < sections; section++) {
+		callbacks->get_num_rows(menu_layer, section, menu_layer->context);
+	}
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer) {
+	return (MenuIndex) { 0, 0 };
+}
+
+void bench_render(void) {
+	Window *top = window_stack_get_top_window();
+	if (!top || !top->root.child || !top->root.child->menu) return;
+	MenuLayer *menu_layer = top->root.child->menu;
+	if (!menu_layer->layer.dirty && !top->root.dirty) return;
+	menu_layer->layer.dirty = false;
+	top->root.dirty = false;
+	bench_stats.renders++;
+	MenuLayerCallbacks *callbacks = &menu_layer->callbacks;
+	GRect screen = SCREEN;
+	int16_t y = 0;
+	uint16_t sections = callbacks->get_num_sections ? callbacks->get_num_sections(menu_layer, menu_layer->context) : 1;
+	for (uint16_t section = 0; section < sections && y < screen.size.h; section++) {
+		int16_t header = callbacks->get_header_height ? callbacks->get_header_height(menu_layer, section, menu_layer->context) : 0;
+		if (header && callbacks->draw_header) callbacks->draw_header(NULL, &menu_layer->layer, section, menu_layer->context);
+		y += header;
+		uint16_t rows = callbacks->get_num_rows(menu_layer, section, menu_layer->context);
+		for (uint16_t row = 0; row < rows && y < screen.size.h; row++) {
+			MenuIndex index = { section, row };
+			y += callbacks->get_cell_height ? callbacks->get_cell_height(menu_layer, &index, menu_layer->context) : 44;
+			callbacks->draw_row(NULL, &menu_layer->layer, &index, menu_layer->context);
+			bench_stats.rows_drawn++;
+		}
+	}
+}
+
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Number windows.
+
+NumberWindow *number_window_create(const char *label, NumberWindowCallbacks callbacks, void *callback_context) {
+	NumberWindow *number_window = calloc(1, sizeof(NumberWindow));
+	number_window->window.root.frame = (GRect) SCREEN;
+	return number_window;
+}
+
+void number_window_destroy(NumberWindow *number_window) {
+	free(number_window);
+}
+
+void number_window_set_max(NumberWindow *numberwindow, int32_t max) {
+}
+
+void number_window_set_min(NumberWindow *numberwindow, int32_t min) {
+}
+
+void number_window_set_step_size(NumberWindow *numberwindow, int32_t step) {
+}
+
+void number_window_set_value(NumberWindow *numberwindow, int32_t value) {
+	numberwindow->value = value;
+}
+
+int32_t number_window_get_value(const NumberWindow *numberwindow) {
+	return numberwindow->value;
+}
+
+Window *number_window_get_window(NumberWindow *numberwindow) {
+	return &numberwindow->window;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Graphics draw nothing; text is measured at a fixed width per character.
+
+static const char *font_keys[8];
+
+GFont fonts_get_system_font(const char *font_key) {
+	uint8_t i = 0;
+	while (i < 7 && font_keys[i] && strcmp(font_keys[i], font_key) != 0) i++;
+	font_keys[i] = font_key;
+	return (GFont) &font_keys[i];
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment, const GTextLayoutCacheRef layout) {
+}
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment) {
+	int16_t width = strlen(text) * 7;
+	int16_t lines = box.size.w ? (width + box.size.w - 1) / box.size.w : 1;
+	return (GSize) { .w = width < box.size.w ? width : box.size.w, .h = lines * 22 };
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+	if (!getenv("BENCH_LOG")) return;
+	va_list args;
+	va_start(args, fmt);
+	fprintf(stderr, "%s:%d ", src_filename, src_line_number);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+void vibes_short_pulse(void) {
+}
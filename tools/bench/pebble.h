@@ -0,0 +1,159 @@
+#pragma once
+
+// Just enough of the Pebble SDK to build the watch code on the host for
+// tools/bench. Layouts that the app depends on (Tuple, the dictionary
+// format) match the SDK; everything else is a fake implemented in fake.c.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+typedef enum { APP_MSG_OK=0, APP_MSG_SEND_TIMEOUT=2, APP_MSG_SEND_REJECTED=4, APP_MSG_NOT_CONNECTED=8, APP_MSG_APP_NOT_RUNNING=16, APP_MSG_INVALID_ARGS=32, APP_MSG_BUSY=64, APP_MSG_BUFFER_OVERFLOW=128, APP_MSG_ALREADY_RELEASED=512, APP_MSG_CALLBACK_ALREADY_REGISTERED=1024, APP_MSG_CALLBACK_NOT_REGISTERED=2048, APP_MSG_OUT_OF_MEMORY=4096, APP_MSG_CLOSED=8192, APP_MSG_INTERNAL_ERROR=16384 } AppMessageResult;
+typedef enum { DICT_OK=0, DICT_NOT_ENOUGH_STORAGE=2, DICT_INVALID_ARGS=4 } DictionaryResult;
+typedef enum { TUPLE_BYTE_ARRAY=0, TUPLE_CSTRING=1, TUPLE_UINT=2, TUPLE_INT=3 } TupleType;
+typedef struct __attribute__((packed)) { uint32_t key; TupleType type:8; uint16_t length; union { uint8_t data[0]; char cstring[0]; uint8_t uint8; uint16_t uint16; uint32_t uint32; int8_t int8; int16_t int16; int32_t int32; } value[]; } Tuple;
+typedef struct { void *dictionary; const void *end; Tuple *cursor; } DictionaryIterator;
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+Tuple *dict_read_first(DictionaryIterator *iter);
+Tuple *dict_read_next(DictionaryIterator *iter);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char * const cstring);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data, const uint16_t size);
+uint32_t dict_write_end(DictionaryIterator *iter);
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator, AppMessageResult reason, void *context);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived);
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped);
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed);
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+typedef enum { APP_LOG_LEVEL_ERROR=1, APP_LOG_LEVEL_WARNING=50, APP_LOG_LEVEL_INFO=100, APP_LOG_LEVEL_DEBUG=200 } AppLogLevel;
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...);
+#define APP_LOG(level, fmt, args...) app_log(level, __FILE__, __LINE__, fmt, ## args)
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+int32_t persist_read_int(const uint32_t key);
+int persist_write_int(const uint32_t key, const int32_t value);
+bool persist_read_bool(const uint32_t key);
+int persist_write_bool(const uint32_t key, const bool value);
+int persist_delete(const uint32_t key);
+#define PERSIST_DATA_MAX_LENGTH 256
+size_t heap_bytes_free(void);
+size_t heap_bytes_used(void);
+typedef struct { int16_t x; int16_t y; } GPoint;
+typedef struct { int16_t w; int16_t h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+typedef enum { GColorClear=~0, GColorBlack=0, GColorWhite=1 } GColor;
+typedef enum { GTextOverflowModeWordWrap, GTextOverflowModeTrailingEllipsis, GTextOverflowModeFill } GTextOverflowMode;
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+typedef struct GContext GContext;
+typedef struct FontInfo *GFont;
+typedef struct GTextLayoutCache *GTextLayoutCacheRef;
+typedef struct Layer Layer;
+typedef struct Window Window;
+typedef struct MenuLayer MenuLayer;
+typedef struct NumberWindow NumberWindow;
+typedef struct GBitmap GBitmap;
+#define FONT_KEY_GOTHIC_14_BOLD "RESOURCE_ID_GOTHIC_14_BOLD"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+GFont fonts_get_system_font(const char *font_key);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, int corner_mask);
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment, const GTextLayoutCacheRef layout);
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment);
+GRect layer_get_bounds(const Layer *layer);
+GRect layer_get_frame(const Layer *layer);
+void layer_mark_dirty(Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_set_hidden(Layer *layer, bool hidden);
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+typedef void (*WindowHandler)(Window *window);
+typedef struct { WindowHandler load; WindowHandler appear; WindowHandler disappear; WindowHandler unload; } WindowHandlers;
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+Layer *window_get_root_layer(const Window *window);
+void window_stack_push(Window *window, bool animated);
+Window *window_stack_pop(bool animated);
+Window *window_stack_get_top_window(void);
+bool window_stack_contains_window(Window *window);
+Window *window_stack_remove(Window *window, bool animated);
+bool window_is_loaded(Window *window);
+typedef struct MenuIndex { uint16_t section; uint16_t row; } MenuIndex;
+#define MENU_CELL_BASIC_HEADER_HEIGHT ((const int16_t) 16)
+typedef uint16_t (*MenuLayerGetNumberOfSectionsCallback)(struct MenuLayer *menu_layer, void *callback_context);
+typedef uint16_t (*MenuLayerGetNumberOfRowsInSectionsCallback)(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+typedef int16_t (*MenuLayerGetCellHeightCallback)(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+typedef int16_t (*MenuLayerGetHeaderHeightCallback)(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+typedef void (*MenuLayerDrawRowCallback)(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
+typedef void (*MenuLayerDrawHeaderCallback)(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
+typedef void (*MenuLayerSelectCallback)(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+typedef void (*MenuLayerSelectionChangedCallback)(struct MenuLayer *menu_layer, MenuIndex new_index, MenuIndex old_index, void *callback_context);
+typedef struct MenuLayerCallbacks { MenuLayerGetNumberOfSectionsCallback get_num_sections; MenuLayerGetNumberOfRowsInSectionsCallback get_num_rows; MenuLayerGetCellHeightCallback get_cell_height; MenuLayerGetHeaderHeightCallback get_header_height; MenuLayerDrawRowCallback draw_row; MenuLayerDrawHeaderCallback draw_header; MenuLayerSelectCallback select_click; MenuLayerSelectCallback select_long_click; MenuLayerSelectionChangedCallback selection_changed; void *get_separator_height; void *draw_separator; } MenuLayerCallbacks;
+MenuLayer *menu_layer_create(GRect frame);
+void menu_layer_destroy(MenuLayer *menu_layer);
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer);
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks);
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, struct Window *window);
+void menu_layer_reload_data(MenuLayer *menu_layer);
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer);
+void menu_cell_basic_header_draw(GContext* ctx, const Layer *cell_layer, const char *title);
+void menu_cell_basic_draw(GContext* ctx, const Layer *cell_layer, const char *title, const char *subtitle, GBitmap *icon);
+typedef void (*NumberWindowCallback)(struct NumberWindow *number_window, void *context);
+typedef struct { NumberWindowCallback incremented; NumberWindowCallback decremented; NumberWindowCallback selected; } NumberWindowCallbacks;
+NumberWindow* number_window_create(const char *label, NumberWindowCallbacks callbacks, void *callback_context);
+void number_window_destroy(NumberWindow* number_window);
+void number_window_set_label(NumberWindow *numberwindow, const char *label);
+void number_window_set_max(NumberWindow *numberwindow, int32_t max);
+void number_window_set_min(NumberWindow *numberwindow, int32_t min);
+void number_window_set_value(NumberWindow *numberwindow, int32_t value);
+void number_window_set_step_size(NumberWindow *numberwindow, int32_t step);
+int32_t number_window_get_value(const NumberWindow *numberwindow);
+Window *number_window_get_window(NumberWindow *numberwindow);
+void vibes_short_pulse(void);
+void vibes_double_pulse(void);
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms);
+void app_event_loop(void);
+void psleep(int millis);
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t * const buffer, const uint16_t size);
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value);
+DictionaryResult dict_write_int16(DictionaryIterator *iter, const uint32_t key, const int16_t value);
+#define ARRAY_LENGTH(array) (sizeof((array))/sizeof((array)[0]))
+void window_set_user_data(Window *window, void *data);
+void* window_get_user_data(const Window *window);
+
+// Every allocation made by the app goes through the fake heap so the bench can report its peak.
+void *bench_malloc(size_t size);
+void *bench_calloc(size_t count, size_t size);
+void *bench_realloc(void *ptr, size_t size);
+void bench_free(void *ptr);
+#define malloc(size) bench_malloc(size)
+#define calloc(count, size) bench_calloc(count, size)
+#define realloc(ptr, size) bench_realloc(ptr, size)
+#define free(ptr) bench_free(ptr)
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Builds the watch code for the host against the fake SDK in this directory
+# and runs the PATCH benchmark. Set CC or BENCH_OUT to override the defaults.
+set -e
+cd "$(dirname "$0")/../.."
+out="${BENCH_OUT:-build/bench}"
+mkdir -p "$out"
+sources=$(ls src/*.c src/windows/*.c | grep -v '^src/main\.c$')
+${CC:-cc} -std=gnu99 -O2 -Wall -Wno-unused-function -Itools/bench -o "$out/bench" $sources tools/bench/fake.c tools/bench/bench.c
+"$out/bench"